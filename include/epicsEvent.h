@@ -112,6 +112,16 @@ public:
      * @param level An unsigned int for the level of information to be displayed.
      **/
     void show ( unsigned level ) const;
+    /**@brief Register another event to be triggered whenever this one is.
+     * @param waiter The event to trigger as well.
+     * @return True if registered, False if another waiter is registered.
+     * @see epicsEventAddWaiter()
+     **/
+    bool addWaiter ( epicsEventId waiter );
+    /**@brief Remove a registration made with addWaiter().
+     * @param waiter The registered event.
+     **/
+    void removeWaiter ( epicsEventId waiter );
 
     class invalidSemaphore;         /* exception payload */
 private:
@@ -211,6 +221,31 @@ epicsShareFunc epicsEventStatus epicsEventTryWait(
 epicsShareFunc void epicsEventShow(
     epicsEventId id, unsigned int level);
 
+/**@brief Register another event to be triggered whenever this one is.
+ *
+ * This lets one thread wait on several objects at once, see
+ * epicsWaitMany(). The waiter is triggered after the event itself, and
+ * at once if the event is already full; it does not empty the event.
+ * Only one waiter may be registered on an event at a time.
+ * @param id The event identifier.
+ * @param waiter The event to trigger as well.
+ * @return \c epicsEventOK if registered, \c epicsEventError if another
+ * waiter is already registered.
+ **/
+epicsShareFunc epicsEventStatus epicsEventAddWaiter(
+    epicsEventId id, epicsEventId waiter);
+
+/**@brief Remove a registration made with epicsEventAddWaiter().
+ *
+ * Nothing happens if a different waiter is registered. A trigger running
+ * at the same time may still trigger the waiter once more, so it must
+ * not be destroyed while the event is in use.
+ * @param id The event identifier.
+ * @param waiter The registered event.
+ **/
+epicsShareFunc void epicsEventRemoveWaiter(
+    epicsEventId id, epicsEventId waiter);
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus */
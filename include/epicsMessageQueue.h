@@ -15,16 +15,84 @@
  * \brief A C++ and a C facility for communication between threads.
  *
  * Each C function corresponds to one of the C++ methods.
+ *
+ * Besides copying messages in and out, a sender can reserve a slot in the
+ * queue, build the message directly in it and then commit or cancel it,
+ * and a receiver can borrow the next message, process it in place and
+ * then release it. The two styles may be mixed on the same queue.
+ *
+ * The batch routines move several messages per call, claiming the room
+ * or the messages for the whole batch in one step and waking at most one
+ * waiting thread, which is much cheaper than sending or receiving the
+ * messages one at a time. In the default implementation that step is a
+ * single acquisition of the queue lock; the Linux implementation takes
+ * no lock, see osdMessageQueue.h.
+ *
+ * A queue may be created with several priority lanes. Each lane has its
+ * own capacity, and receivers always take the first message from the
+ * highest priority lane that is not empty, so urgent messages are not held
+ * up behind bulk traffic that fills the lower lanes. Only
+ * epicsMessageQueueTrySendPriority() can send to a lane other than
+ * priority 0: all other send routines, the batch sends and reserved
+ * slots use priority 0 and its capacity. The batch receives take messages
+ * in the order repeated single receives would.
+ *
+ * Every queue keeps running statistics: its high-water mark, message
+ * counts and histograms of how long senders were blocked on a full queue
+ * and receivers waited on an empty one. In the default implementation
+ * they are updated while the sending or receiving thread holds the queue
+ * lock, which it takes for the transfer anyway, and
+ * epicsMessageQueueGetStats() copies them under the same lock so the
+ * snapshot is consistent. Implementations without a queue lock keep them
+ * in their own atomic counters, and the snapshot is then only consistent
+ * for each field on its own.
+ *
+ * On VxWorks and RTEMS, which use their native message queues, the
+ * counters are updated with interrupts locked out so that a trySend()
+ * from an interrupt handler is counted in \c sent, \c sendFailed and the
+ * high-water mark like any other. Such a send never blocks, so it adds
+ * nothing to the blocked-time histograms.
  */
 
 #ifndef epicsMessageQueueh
 #define epicsMessageQueueh
 
 #include "epicsAssert.h"
+#include "epicsEvent.h"
+#include "epicsTypes.h"
 #include "shareLib.h"
 
 typedef struct epicsMessageQueueOSD *epicsMessageQueueId;
 
+/** Number of buckets in the wait time histograms of
+ *  epicsMessageQueueStats. Bucket 0 counts waits shorter than 1
+ *  microsecond, bucket \c i counts waits of at least 2^(i-1) but less
+ *  than 2^i microseconds, and the last bucket counts all longer waits.
+ **/
+#define EPICS_MESSAGE_QUEUE_WAIT_BUCKETS 24
+
+/** Statistics gathered by a message queue since it was created or its
+ *  statistics were last reset.
+ **/
+typedef struct epicsMessageQueueStats {
+    /** Largest number of messages queued at one time */
+    unsigned int highWaterMark;
+    /** Number of messages sent or queued */
+    epicsUInt64 sent;
+    /** Number of messages received */
+    epicsUInt64 received;
+    /** Number of sends that failed because the queue was full */
+    epicsUInt64 sendFailed;
+    /** Total time senders spent blocked on a full queue, in seconds */
+    double sendBlockedTime;
+    /** Total time receivers spent waiting on an empty queue, in seconds */
+    double receiveWaitTime;
+    /** Histogram of the time each blocked send waited */
+    epicsUInt64 sendBlocked[EPICS_MESSAGE_QUEUE_WAIT_BUCKETS];
+    /** Histogram of the time each waiting receive waited */
+    epicsUInt64 receiveWait[EPICS_MESSAGE_QUEUE_WAIT_BUCKETS];
+} epicsMessageQueueStats;
+
 #ifdef __cplusplus
 
 /** Provides methods for sending messages between threads on a first in,
@@ -57,6 +125,18 @@ public:
     epicsMessageQueue ( unsigned int capacity,
                         unsigned int maximumMessageSize );
 
+    /**
+     *  \brief Constructor for a queue with priority lanes.
+     *  \param capacity  Maximum number of messages to queue in each lane
+     *  \param maximumMessageSize  Number of bytes of the largest
+     *  message that may be queued
+     *  \param priorities  Number of lanes; priority 0 is the lowest and
+     *  \p priorities - 1 the highest
+     **/
+    epicsMessageQueue ( unsigned int capacity,
+                        unsigned int maximumMessageSize,
+                        unsigned int priorities );
+
     /**
      *  \brief Destructor.
      **/
@@ -73,6 +153,21 @@ public:
      **/
     int trySend ( void *message, unsigned int messageSize );
 
+    /**
+     *  \brief Try to send a message at a given priority.
+     *  Messages sent with any other send method, including the batch
+     *  sends and commit(), go to priority 0.
+     *  \note On VxWorks and RTEMS this method may be called from
+     *  an interrupt handler.
+     *  \returns 0 if the message was sent to a receiver or queued for
+     *  future delivery.
+     *  \returns -1 if no more messages can be queued in that lane, if
+     *  the message is larger than the queue’s maximum message size, or
+     *  if \p priority is not less than the number of lanes.
+     **/
+    int trySend ( void *message, unsigned int messageSize,
+                  unsigned int priority );
+
     /**
      *  \brief Send a message.
      *  \returns 0 if the message was sent to a receiver or queued for
@@ -139,18 +234,187 @@ public:
      **/
     int receive ( void *message, unsigned int size, double timeout );
 
+    /**
+     *  \brief Try to send several messages.
+     *  Queues as many of the messages as there is room for, in order,
+     *  at priority 0.
+     *  \param messages Array of \p count message pointers.
+     *  \param sizes Array of \p count message sizes.
+     *  \param count Number of messages to send.
+     *  \returns The number of messages sent or queued, which may be 0.
+     *  \returns -1 if the first message is larger than the queue’s
+     *  maximum message size; sending always stops before a message that
+     *  is too large.
+     **/
+    int trySendMany ( void * const *messages, const unsigned int *sizes,
+                      unsigned int count );
+
+    /**
+     *  \brief Send several messages, waiting while the queue is full.
+     *  The messages go to priority 0.
+     *  \returns The number of messages sent or queued.
+     *  \returns -1 if the first message is larger than the queue’s
+     *  maximum message size; sending always stops before a message that
+     *  is too large.
+     **/
+    int sendMany ( void * const *messages, const unsigned int *sizes,
+                   unsigned int count );
+
+    /**
+     *  \brief Try to receive several messages.
+     *  Moves up to \p count messages off the queue, highest priority
+     *  lane first. Message \c i is
+     *  stored at \p buffer + \c i * \p size and its length is returned
+     *  in \p sizes[i].
+     *  \param buffer Storage for \p count messages of \p size bytes.
+     *  \param size Number of bytes reserved for each message.
+     *  \param sizes Array to receive the \p count message lengths.
+     *  \param count Maximum number of messages to receive.
+     *  \returns The number of messages received, which may be 0.
+     *  \returns -1 if the first message is too large for \p size.
+     **/
+    int tryReceiveMany ( void *buffer, unsigned int size,
+                         unsigned int *sizes, unsigned int count );
+
+    /**
+     *  \brief Receive several messages, waiting if the queue is empty.
+     *  Waits for at least one message, then moves up to \p count
+     *  messages as tryReceiveMany() does.
+     *  \returns The number of messages received.
+     *  \returns -1 if the first message is too large for \p size.
+     **/
+    int receiveMany ( void *buffer, unsigned int size,
+                      unsigned int *sizes, unsigned int count );
+
+    /**
+     *  \brief Receive several messages or timeout.
+     *  \returns The number of messages received, 0 if no message arrived
+     *  within the timeout interval.
+     *  \returns -1 if the first message is too large for \p size.
+     **/
+    int receiveMany ( void *buffer, unsigned int size,
+                      unsigned int *sizes, unsigned int count,
+                      double timeout );
+
+    /**
+     *  \brief Try to reserve a slot for building a message in place.
+     *  The slot holds up to maximumMessageSize bytes and counts against
+     *  the capacity of priority 0, where commit() queues the message,
+     *  until it is committed or cancelled.
+     *  \returns Pointer to the slot storage.
+     *  \returns 0 if no more messages can be queued.
+     **/
+    void * tryReserve ();
+
+    /**
+     *  \brief Reserve a slot, waiting if the queue is full.
+     *  \returns Pointer to the slot storage.
+     **/
+    void * reserve ();
+
+    /**
+     *  \brief Reserve a slot or timeout.
+     *  \returns Pointer to the slot storage.
+     *  \returns 0 if the timeout was reached before a slot became free.
+     **/
+    void * reserve ( double timeout );
+
+    /**
+     *  \brief Queue a message built in a reserved slot.
+     *  \param slot Pointer returned by tryReserve() or reserve().
+     *  \param messageSize Number of bytes of the message.
+     *  \returns 0 if the message was sent to a receiver or queued for
+     *  future delivery.
+     *  \returns -1 if the message is larger than the queue’s maximum
+     *  message size, in which case the slot is released.
+     **/
+    int commit ( void *slot, unsigned int messageSize );
+
+    /**
+     *  \brief Give back a reserved slot without sending a message.
+     *  The slot becomes free again and a sender waiting for space is
+     *  woken.
+     *  \param slot Pointer returned by tryReserve() or reserve().
+     **/
+    void cancel ( void *slot );
+
+    /**
+     *  \brief Try to borrow the first message on the queue.
+     *  The message stays in queue storage, and its slot is not reused
+     *  until it is handed back with release().
+     *  \param messageSize Set to the number of bytes in the message.
+     *  \returns Pointer to the message.
+     *  \returns 0 if the message queue is empty.
+     **/
+    void * tryBorrow ( unsigned int &messageSize );
+
+    /**
+     *  \brief Borrow the first message, waiting if the queue is empty.
+     *  \param messageSize Set to the number of bytes in the message.
+     *  \returns Pointer to the message.
+     **/
+    void * borrow ( unsigned int &messageSize );
+
+    /**
+     *  \brief Borrow the first message or timeout.
+     *  \param messageSize Set to the number of bytes in the message.
+     *  \returns Pointer to the message.
+     *  \returns 0 if a message is not received within the timeout
+     *  interval.
+     **/
+    void * borrow ( unsigned int &messageSize, double timeout );
+
+    /**
+     *  \brief Hand back a borrowed message so its slot can be reused.
+     *  \param message Pointer returned by tryBorrow() or borrow().
+     **/
+    void release ( void *message );
+
     /**
      *  \brief Displays some information about the message queue.
      *  \param level Controls the amount of information displayed.
+     *  Levels above 0 include the queue statistics.
      **/
     void show ( unsigned int level = 0 );
 
+    /**
+     *  \brief Copy the queue statistics.
+     *  \param stats Filled in with a snapshot of the statistics.
+     **/
+    void getStats ( epicsMessageQueueStats &stats );
+
+    /**
+     *  \brief Clear the queue statistics.
+     *  The high-water mark is set to the number of messages presently
+     *  in the queue.
+     **/
+    void resetStats ();
+
     /**
      *  \brief How many messages are queued.
      *  \returns The number of messages presently in the queue.
      **/
     unsigned int pending ();
 
+    /**
+     *  \brief Register an event to be signalled when a message is queued.
+     *  This lets one thread wait on several objects at once, see
+     *  epicsWaitMany(). Only one event may be registered on a queue.
+     *  \param event Event to signal.
+     *  \returns 0 if the event was registered.
+     *  \returns -1 if another event is already registered.
+     **/
+    int addWaiter ( epicsEventId event );
+
+    /**
+     *  \brief Remove a registration made with addWaiter().
+     *  Nothing happens if a different event is registered. A sender may
+     *  signal the event shortly after it has been removed, so it must
+     *  not be destroyed while the queue is in use.
+     *  \param event The registered event.
+     **/
+    void removeWaiter ( epicsEventId event );
+
 private:
     /**
      *  Prevent compiler-generated member functions default constructor,
@@ -177,6 +441,23 @@ epicsShareFunc epicsMessageQueueId epicsShareAPI epicsMessageQueueCreate(
     unsigned int capacity,
     unsigned int maximumMessageSize);
 
+/**
+ *  \brief Create a message queue with priority lanes.
+ *
+ *  Receivers always take the first message from the highest priority
+ *  lane that holds one.
+ *  \param capacity  Maximum number of messages to queue in each lane
+ *  \param maximumMessageSize  Number of bytes of the largest
+ *  message that may be queued
+ *  \param priorities  Number of lanes; priority 0 is the lowest and
+ *  \p priorities - 1 the highest
+ *  \return An identifier for the new queue, or 0.
+ **/
+epicsShareFunc epicsMessageQueueId epicsShareAPI epicsMessageQueueCreatePriority(
+    unsigned int capacity,
+    unsigned int maximumMessageSize,
+    unsigned int priorities);
+
 /**
  *  \brief Destroy a message queue, release all its memory.
  **/
@@ -197,6 +478,25 @@ epicsShareFunc int epicsShareAPI epicsMessageQueueTrySend(
     void *message,
     unsigned int messageSize);
 
+/**
+ *  \brief Try to send a message at a given priority.
+ *
+ *  Messages sent with any other send routine, including the batch sends
+ *  and epicsMessageQueueCommit(), go to priority 0.
+ *  \note On VxWorks and RTEMS this routine may be called from
+ *  an interrupt handler.
+ *  \returns 0 if the message was sent to a receiver or queued for
+ *  future delivery.
+ *  \returns -1 if no more messages can be queued in that lane, if the
+ *  message is larger than the queue’s maximum message size, or if
+ *  \p priority is not less than the number of lanes.
+ **/
+epicsShareFunc int epicsShareAPI epicsMessageQueueTrySendPriority(
+    epicsMessageQueueId id,
+    void *message,
+    unsigned int messageSize,
+    unsigned int priority);
+
 /**
  *  \brief Send a message.
  *  \returns 0 if the message was sent to a receiver or queued for
@@ -283,6 +583,202 @@ epicsShareFunc int epicsShareAPI epicsMessageQueueReceiveWithTimeout(
     unsigned int size,
     double timeout);
 
+/**
+ *  \brief Try to send several messages.
+ *
+ *  Queues as many of the messages as there is room for, in order, at
+ *  priority 0, claiming the room for all of them in one step.
+ *  \param id Message queue identifier.
+ *  \param messages Array of \p count message pointers.
+ *  \param sizes Array of \p count message sizes.
+ *  \param count Number of messages to send.
+ *  \returns The number of messages sent or queued, which may be 0.
+ *  \returns -1 if the first message is larger than the queue’s maximum
+ *  message size; sending always stops before a message that is too large.
+ **/
+epicsShareFunc int epicsShareAPI epicsMessageQueueTrySendMany(
+    epicsMessageQueueId id,
+    void * const *messages,
+    const unsigned int *sizes,
+    unsigned int count);
+
+/**
+ *  \brief Send several messages, waiting while the queue is full.
+ *
+ *  The messages go to priority 0.
+ *  \param id Message queue identifier.
+ *  \param messages Array of \p count message pointers.
+ *  \param sizes Array of \p count message sizes.
+ *  \param count Number of messages to send.
+ *  \returns The number of messages sent or queued.
+ *  \returns -1 if the first message is larger than the queue’s maximum
+ *  message size; sending always stops before a message that is too large.
+ **/
+epicsShareFunc int epicsShareAPI epicsMessageQueueSendMany(
+    epicsMessageQueueId id,
+    void * const *messages,
+    const unsigned int *sizes,
+    unsigned int count);
+
+/**
+ *  \brief Try to receive several messages.
+ *
+ *  Moves up to \p count messages off the queue, highest priority lane
+ *  first, claiming them all in one step. Message \c i is stored at
+ *  \p buffer + \c i * \p size and its length is returned in
+ *  \p sizes[i].
+ *  \param id Message queue identifier.
+ *  \param buffer Storage for \p count messages of \p size bytes.
+ *  \param size Number of bytes reserved for each message.
+ *  \param sizes Array to receive the \p count message lengths.
+ *  \param count Maximum number of messages to receive.
+ *  \returns The number of messages received, which may be 0.
+ *  \returns -1 if the first message is too large for \p size.
+ **/
+epicsShareFunc int epicsShareAPI epicsMessageQueueTryReceiveMany(
+    epicsMessageQueueId id,
+    void *buffer,
+    unsigned int size,
+    unsigned int *sizes,
+    unsigned int count);
+
+/**
+ *  \brief Receive several messages, waiting if the queue is empty.
+ *
+ *  Waits for at least one message, then moves up to \p count messages
+ *  as epicsMessageQueueTryReceiveMany() does.
+ *  \returns The number of messages received.
+ *  \returns -1 if the first message is too large for \p size.
+ **/
+epicsShareFunc int epicsShareAPI epicsMessageQueueReceiveMany(
+    epicsMessageQueueId id,
+    void *buffer,
+    unsigned int size,
+    unsigned int *sizes,
+    unsigned int count);
+
+/**
+ *  \brief Receive several messages or timeout.
+ *
+ *  Waits up to \p timeout seconds for at least one message, then moves
+ *  up to \p count messages as epicsMessageQueueTryReceiveMany() does.
+ *  \returns The number of messages received, 0 if no message arrived
+ *  within the timeout interval.
+ *  \returns -1 if the first message is too large for \p size.
+ **/
+epicsShareFunc int epicsShareAPI epicsMessageQueueReceiveManyWithTimeout(
+    epicsMessageQueueId id,
+    void *buffer,
+    unsigned int size,
+    unsigned int *sizes,
+    unsigned int count,
+    double timeout);
+
+/**
+ *  \brief Try to reserve a slot for building a message in place.
+ *
+ *  The slot holds up to maximumMessageSize bytes and counts against the
+ *  capacity of priority 0, where epicsMessageQueueCommit() queues the
+ *  message, until it is committed or cancelled.
+ *  \param id Message queue identifier.
+ *  \returns Pointer to the slot storage.
+ *  \returns NULL if no more messages can be queued.
+ **/
+epicsShareFunc void * epicsShareAPI epicsMessageQueueTryReserve(
+    epicsMessageQueueId id);
+
+/**
+ *  \brief Reserve a slot, waiting if the queue is full.
+ *  \param id Message queue identifier.
+ *  \returns Pointer to the slot storage.
+ **/
+epicsShareFunc void * epicsShareAPI epicsMessageQueueReserve(
+    epicsMessageQueueId id);
+
+/**
+ *  \brief Reserve a slot or timeout.
+ *  \param id Message queue identifier.
+ *  \param timeout Maximum time to wait in seconds.
+ *  \returns Pointer to the slot storage.
+ *  \returns NULL if the timeout was reached before a slot became free.
+ **/
+epicsShareFunc void * epicsShareAPI epicsMessageQueueReserveWithTimeout(
+    epicsMessageQueueId id,
+    double timeout);
+
+/**
+ *  \brief Queue a message built in a reserved slot.
+ *  \param id Message queue identifier.
+ *  \param slot Pointer returned by one of the reserve routines.
+ *  \param messageSize Number of bytes of the message.
+ *  \returns 0 if the message was sent to a receiver or queued for
+ *  future delivery.
+ *  \returns -1 if the message is larger than the queue’s maximum
+ *  message size, in which case the slot is released.
+ **/
+epicsShareFunc int epicsShareAPI epicsMessageQueueCommit(
+    epicsMessageQueueId id,
+    void *slot,
+    unsigned int messageSize);
+
+/**
+ *  \brief Give back a reserved slot without sending a message.
+ *
+ *  The slot becomes free again and a sender waiting for space is woken.
+ *  \param id Message queue identifier.
+ *  \param slot Pointer returned by one of the reserve routines.
+ **/
+epicsShareFunc void epicsShareAPI epicsMessageQueueCancel(
+    epicsMessageQueueId id,
+    void *slot);
+
+/**
+ *  \brief Try to borrow the first message on the queue.
+ *
+ *  The message stays in queue storage, and its slot is not reused until
+ *  it is handed back with epicsMessageQueueRelease().
+ *  \param id Message queue identifier.
+ *  \param messageSize Set to the number of bytes in the message.
+ *  \returns Pointer to the message.
+ *  \returns NULL if the message queue is empty.
+ **/
+epicsShareFunc void * epicsShareAPI epicsMessageQueueTryBorrow(
+    epicsMessageQueueId id,
+    unsigned int *messageSize);
+
+/**
+ *  \brief Borrow the first message, waiting if the queue is empty.
+ *  \param id Message queue identifier.
+ *  \param messageSize Set to the number of bytes in the message.
+ *  \returns Pointer to the message.
+ **/
+epicsShareFunc void * epicsShareAPI epicsMessageQueueBorrow(
+    epicsMessageQueueId id,
+    unsigned int *messageSize);
+
+/**
+ *  \brief Borrow the first message or timeout.
+ *  \param id Message queue identifier.
+ *  \param messageSize Set to the number of bytes in the message.
+ *  \param timeout Maximum time to wait in seconds.
+ *  \returns Pointer to the message.
+ *  \returns NULL if a message is not received within the timeout
+ *  interval.
+ **/
+epicsShareFunc void * epicsShareAPI epicsMessageQueueBorrowWithTimeout(
+    epicsMessageQueueId id,
+    unsigned int *messageSize,
+    double timeout);
+
+/**
+ *  \brief Hand back a borrowed message so its slot can be reused.
+ *  \param id Message queue identifier.
+ *  \param message Pointer returned by one of the borrow routines.
+ **/
+epicsShareFunc void epicsShareAPI epicsMessageQueueRelease(
+    epicsMessageQueueId id,
+    void *message);
+
 /**
  *  \brief How many messages are queued.
  *  \param id Message queue identifier.
@@ -291,15 +787,62 @@ epicsShareFunc int epicsShareAPI epicsMessageQueueReceiveWithTimeout(
 epicsShareFunc int epicsShareAPI epicsMessageQueuePending(
     epicsMessageQueueId id);
 
+/**
+ *  \brief Register an event to be signalled when a message is queued.
+ *
+ *  This lets one thread wait on several objects at once, see
+ *  epicsWaitMany(). Only one event may be registered on a queue.
+ *  \param id Message queue identifier.
+ *  \param event Event to signal.
+ *  \returns 0 if the event was registered.
+ *  \returns -1 if another event is already registered.
+ **/
+epicsShareFunc int epicsShareAPI epicsMessageQueueAddWaiter(
+    epicsMessageQueueId id,
+    epicsEventId event);
+
+/**
+ *  \brief Remove a registration made with epicsMessageQueueAddWaiter().
+ *
+ *  Nothing happens if a different event is registered. A sender may
+ *  signal the event shortly after it has been removed, so it must not be
+ *  destroyed while the queue is in use.
+ *  \param id Message queue identifier.
+ *  \param event The registered event.
+ **/
+epicsShareFunc void epicsShareAPI epicsMessageQueueRemoveWaiter(
+    epicsMessageQueueId id,
+    epicsEventId event);
+
 /**
  *  \brief Displays some information about the message queue.
  *  \param id Message queue identifier.
  *  \param level Controls the amount of information displayed.
+ *  Levels above 0 include the queue statistics.
  **/
 epicsShareFunc void epicsShareAPI epicsMessageQueueShow(
     epicsMessageQueueId id,
     int level);
 
+/**
+ *  \brief Copy the queue statistics.
+ *  \param id Message queue identifier.
+ *  \param stats Filled in with a snapshot of the statistics.
+ **/
+epicsShareFunc void epicsShareAPI epicsMessageQueueGetStats(
+    epicsMessageQueueId id,
+    epicsMessageQueueStats *stats);
+
+/**
+ *  \brief Clear the queue statistics.
+ *
+ *  The high-water mark is set to the number of messages presently in
+ *  the queue.
+ *  \param id Message queue identifier.
+ **/
+epicsShareFunc void epicsShareAPI epicsMessageQueueResetStats(
+    epicsMessageQueueId id);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
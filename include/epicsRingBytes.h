@@ -22,21 +22,81 @@
  * @note If there is only one writer it is not necessary to lock for puts.
  * If there is a single reader it is not necessary to lock for gets.
  * epicsRingBytesLocked uses a spinlock.
+ *
+ * Besides copying through a caller's buffer with epicsRingBytesPut() and
+ * epicsRingBytesGet(), data can be written and read in place. A writer
+ * reserves space with epicsRingBytesReserveWrite(), fills the returned
+ * spans and publishes them with epicsRingBytesCommitWrite(). A reader
+ * looks at stored data with epicsRingBytesPeekRead() and releases it with
+ * epicsRingBytesConsumeRead(). Because the ring wraps around, a region is
+ * returned as up to two spans, the second starting at the beginning of
+ * the ring storage.
+ *
+ * A mirrored ring buffer maps its storage twice, back to back, into the
+ * address space so that the bytes following the end of the ring are the
+ * bytes at its start. Every region of a mirrored ring is contiguous, and
+ * the in-place calls always return it as a single span.
+ *
+ * A reader can block until enough data is available with
+ * epicsRingBytesWaitUsed(), once waiting has been enabled on the ring.
+ * Writers only signal the reader when it is actually parked, so a busy
+ * ring never makes a system call.
+ *
+ * The ring can also carry variable-length records. Each record is stored
+ * with an inline length header of EPICS_RING_BYTES_RECORD_HEADER bytes,
+ * without padding, and is always put or got as a whole. The largest
+ * record a ring can hold is therefore its size less one header. The
+ * record calls must not be mixed with the plain byte calls on one ring.
+ * The byte counts of the plain calls, such as epicsRingBytesUsedBytes(),
+ * epicsRingBytesFreeBytes(), epicsRingBytesWaitUsed() and the high water
+ * mark, include the headers when used on a ring of records.
+ * Records are at least one byte long, so a record call that returns a
+ * length of zero always means the ring is empty or nothing was stored.
+ *
+ * A shared ring buffer keeps its indices and storage in a named shared
+ * memory object, so that a writer in one process and a reader in another
+ * process on the same host can use it with the normal calls. The indices
+ * are only ever advanced after the data they cover has been copied, so a
+ * process that dies part way through a put or get leaves the ring
+ * consistent. Waiting is always enabled on a shared ring: the wait state
+ * lives in the shared memory object next to the indices, and a waiting
+ * reader is woken with a process-shared futex.
+ *
+ * An overwrite ring buffer never rejects a put. When there is not enough
+ * space it discards the oldest data to make room and counts what was
+ * discarded, so readers can detect gaps. A byte overwrite ring discards
+ * and counts bytes, a record overwrite ring whole records. Since a put
+ * may discard data a reader is looking at, the in-place read calls are
+ * not available on overwrite rings.
  */
 
 #ifndef INCepicsRingBytesh
 #define INCepicsRingBytesh
 
+#include <stddef.h>
+
+#include "epicsEvent.h"
+#include "shareLib.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#include "shareLib.h"
-
 /** @brief An identifier for a ring buffer */
 typedef void *epicsRingBytesId;
 typedef void const *epicsRingBytesIdConst;
 
+/** @brief Bytes of ring storage taken by the length header of a record */
+#define EPICS_RING_BYTES_RECORD_HEADER sizeof(int)
+
+/** @brief A contiguous region of ring buffer storage */
+typedef struct epicsRingBytesSpan {
+    /** @brief First byte of the region */
+    char *data;
+    /** @brief Length of the region in bytes, may be zero */
+    int nbytes;
+} epicsRingBytesSpan;
+
 /**
  * @brief Create a new ring buffer
  * @param nbytes Size of ring buffer to create
@@ -49,9 +109,90 @@ epicsShareFunc epicsRingBytesId  epicsShareAPI epicsRingBytesCreate(int nbytes);
  * @return Ring buffer Id or NULL on failure
  */
 epicsShareFunc epicsRingBytesId  epicsShareAPI epicsRingBytesLockedCreate(int nbytes);
+/**
+ * @brief Create a new ring buffer that discards its oldest data when a
+ * put does not fit
+ *
+ * The ring is secured by a spinlock. Only the plain byte calls may be
+ * used on it.
+ * @param nbytes Size of ring buffer to create
+ * @return Ring buffer Id or NULL on failure
+ */
+epicsShareFunc epicsRingBytesId  epicsShareAPI epicsRingBytesOverwriteCreate(int nbytes);
+/**
+ * @brief Create a new record ring buffer that discards its oldest
+ * records when a put does not fit
+ *
+ * The ring is secured by a spinlock. Only the record calls may be used
+ * on it, and whole records are discarded.
+ * @param nbytes Size of ring buffer to create
+ * @return Ring buffer Id or NULL on failure
+ */
+epicsShareFunc epicsRingBytesId  epicsShareAPI epicsRingBytesOverwriteRecordCreate(int nbytes);
+/**
+ * @brief Create a new ring buffer with mirrored storage
+ *
+ * The storage is mapped twice in consecutive virtual memory, so no read
+ * or write region is ever split at the wraparound point. On Linux this
+ * uses an anonymous memfd mapped twice with mmap().
+ * @param nbytes Minimum size of ring buffer to create; this is rounded up
+ * to a multiple of the page size
+ * @return Ring buffer Id, or NULL on failure or on targets where mirrored
+ * mappings are not supported
+ * @note epicsRingBytesSize() reports the rounded-up size.
+ */
+epicsShareFunc epicsRingBytesId  epicsShareAPI epicsRingBytesMirroredCreate(int nbytes);
+/**
+ * @brief Create a new ring buffer with mirrored storage, secured by a
+ * spinlock
+ * @param nbytes Minimum size of ring buffer to create; this is rounded up
+ * to a multiple of the page size
+ * @return Ring buffer Id, or NULL on failure or on targets where mirrored
+ * mappings are not supported
+ * @note epicsRingBytesSize() reports the rounded-up size.
+ */
+epicsShareFunc epicsRingBytesId  epicsShareAPI epicsRingBytesMirroredLockedCreate(int nbytes);
+/**
+ * @brief Create a new ring buffer in named shared memory
+ *
+ * Only one process may write to and one process may read from a shared
+ * ring buffer; it can not be locked. Waiting is enabled as the ring is
+ * created, so epicsRingBytesWaitUsed() works in any attached process
+ * without calling epicsRingBytesEnableWait().
+ *
+ * If the reading process dies while parked in epicsRingBytesWaitUsed()
+ * its wait request stays set in the shared memory object. This is
+ * harmless: writers then make one futex wake system call per put that
+ * finds no-one to wake, until the next reader to wait replaces the
+ * request with its own, or returns and clears it.
+ * @param name Name of the shared memory object, which must not exist
+ * @param nbytes Size of ring buffer to create
+ * @return Ring buffer Id, or NULL on failure or on targets where shared
+ * ring buffers are not supported
+ */
+epicsShareFunc epicsRingBytesId  epicsShareAPI epicsRingBytesSharedCreate(
+    const char *name, int nbytes);
+/**
+ * @brief Attach to a ring buffer created by epicsRingBytesSharedCreate()
+ * @param name Name of the shared memory object
+ * @return Ring buffer Id, or NULL if the object does not exist or does
+ * not hold a ring buffer
+ */
+epicsShareFunc epicsRingBytesId  epicsShareAPI epicsRingBytesSharedOpen(
+    const char *name);
+/**
+ * @brief Remove the name of a shared ring buffer
+ *
+ * Processes that are attached may carry on using the ring buffer, which
+ * is released after the last of them calls epicsRingBytesDelete().
+ * @param name Name of the shared memory object
+ * @return 0 on success, -1 if the name does not exist
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesSharedUnlink(const char *name);
 /**
  * @brief Delete the ring buffer and free any associated memory
  * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @note For a shared ring buffer this only detaches the calling process.
  */
 epicsShareFunc void epicsShareAPI epicsRingBytesDelete(epicsRingBytesId id);
 /**
@@ -68,7 +209,9 @@ epicsShareFunc int  epicsShareAPI epicsRingBytesGet(
  * @param id RingbufferID returned by epicsRingBytesCreate()
  * @param value Source of the data to be put into the buffer
  * @param nbytes How many bytes to put
- * @return The number of bytes actually stored, zero if not enough space
+ * @return The number of bytes actually stored, zero if not enough space.
+ * An overwrite ring always stores the data, keeping only the last
+ * epicsRingBytesSize() bytes if @c nbytes is larger than that.
  */
 epicsShareFunc int  epicsShareAPI epicsRingBytesPut(
     epicsRingBytesId id, char *value,int nbytes);
@@ -81,13 +224,16 @@ epicsShareFunc void epicsShareAPI epicsRingBytesFlush(epicsRingBytesId id);
 /**
  * @brief Return the number of free bytes in the ring buffer
  * @param id RingbufferID returned by epicsRingBytesCreate()
- * @return The number of free bytes in the ring buffer
+ * @return The number of free bytes in the ring buffer. On a ring of
+ * records the largest record that would fit is this less
+ * EPICS_RING_BYTES_RECORD_HEADER.
  */
 epicsShareFunc int  epicsShareAPI epicsRingBytesFreeBytes(epicsRingBytesId id);
 /**
  * @brief Return the number of bytes currently stored in the ring buffer
  * @param id RingbufferID returned by epicsRingBytesCreate()
- * @return The number of bytes currently stored in the ring buffer
+ * @return The number of bytes currently stored in the ring buffer,
+ * including record headers on a ring of records
  */
 epicsShareFunc int  epicsShareAPI epicsRingBytesUsedBytes(epicsRingBytesId id);
 /**
@@ -113,8 +259,8 @@ epicsShareFunc int  epicsShareAPI epicsRingBytesIsFull(epicsRingBytesId id);
  * @brief See how full a ring buffer has been since it was last checked.
  *
  * Returns the maximum amount of data the ring buffer has held in bytes
- * since the water mark was last reset. A new ring buffer starts with a
- * water mark of 0.
+ * since the water mark was last reset, including record headers on a
+ * ring of records. A new ring buffer starts with a water mark of 0.
  * @param id RingbufferID returned by epicsRingBytesCreate()
  * @return Actual Highwater mark
  */
@@ -126,6 +272,205 @@ epicsShareFunc int  epicsShareAPI epicsRingBytesHighWaterMark(epicsRingBytesIdCo
  * @param id RingbufferID returned by epicsRingBytesCreate()
  */
 epicsShareFunc void epicsShareAPI epicsRingBytesResetHighWaterMark(epicsRingBytesId id);
+/**
+ * @brief Get how much data an overwrite ring buffer has discarded
+ *
+ * The count only ever increases, so a reader can compare two values to
+ * find out whether it missed any data in between.
+ * @param id RingbufferID returned by epicsRingBytesOverwriteCreate() or
+ * epicsRingBytesOverwriteRecordCreate()
+ * @return Number of bytes discarded since the ring was created, or the
+ * number of records for a ring from epicsRingBytesOverwriteRecordCreate().
+ * Always 0 for other kinds of ring buffer.
+ */
+epicsShareFunc size_t epicsShareAPI epicsRingBytesDropped(epicsRingBytesIdConst id);
+/**
+ * @brief Reserve free space in the ring buffer for writing in place
+ *
+ * Nothing becomes visible to readers until epicsRingBytesCommitWrite()
+ * is called. A new reservation replaces any uncommitted one.
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param nbytes Maximum number of bytes to reserve
+ * @param span Filled in with up to two spans of ring storage; unused
+ * spans are given a length of zero
+ * @return The number of bytes actually reserved, the sum of the span
+ * lengths
+ * @note Only one thread may hold a reservation at a time, even on a
+ * locked ring buffer; the lock is only taken inside the calls.
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesReserveWrite(
+    epicsRingBytesId id, int nbytes, epicsRingBytesSpan span[2]);
+/**
+ * @brief Make reserved data visible to readers
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param nbytes How many of the reserved bytes have been written, from
+ * the start of the first span
+ * @return The number of bytes actually committed, never more than were
+ * reserved
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesCommitWrite(
+    epicsRingBytesId id, int nbytes);
+/**
+ * @brief Look at data in the ring buffer without removing it
+ *
+ * The spans stay valid until the data is released with
+ * epicsRingBytesConsumeRead() or the ring buffer is flushed.
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param nbytes Maximum number of bytes to look at
+ * @param span Filled in with up to two spans of ring storage; unused
+ * spans are given a length of zero
+ * @return The number of bytes available, the sum of the span lengths.
+ * Always zero on an overwrite ring buffer.
+ * @note Only one thread may read in place at a time, even on a locked
+ * ring buffer.
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesPeekRead(
+    epicsRingBytesId id, int nbytes, epicsRingBytesSpan span[2]);
+/**
+ * @brief Remove data from the ring buffer after reading it in place
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param nbytes How many bytes to remove from the front of the ring
+ * @return The number of bytes actually removed
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesConsumeRead(
+    epicsRingBytesId id, int nbytes);
+
+/**
+ * @brief Allow a reader to block on the ring buffer
+ *
+ * Must be called before the ring is shared with other threads. Does
+ * nothing on a shared ring, where waiting is always enabled.
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ */
+epicsShareFunc void epicsShareAPI epicsRingBytesEnableWait(epicsRingBytesId id);
+/**
+ * @brief Wait until the ring buffer holds at least @c nbytes bytes
+ *
+ * Writers only signal the reader while it is waiting here. On a ring of
+ * records the count includes the record headers, so waiting for
+ * EPICS_RING_BYTES_RECORD_HEADER + 1 bytes waits for any record.
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param nbytes Number of bytes to wait for, limited to the size of the
+ * ring
+ * @return 1 if the data is available, 0 if waiting has not been enabled
+ * on this ring or another waiter is registered
+ * @note Only one thread may wait on a ring at a time.
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesWaitUsed(
+    epicsRingBytesId id, int nbytes);
+/**
+ * @brief Wait until the ring buffer holds at least @c nbytes bytes or
+ * until the specified timeout
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param nbytes Number of bytes to wait for, limited to the size of the
+ * ring
+ * @param timeout The timeout delay in seconds
+ * @return 1 if the data is available, 0 on timeout, if waiting has not
+ * been enabled on this ring or if another waiter is registered
+ * @note Only one thread may wait on a ring at a time.
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesWaitUsedWithTimeout(
+    epicsRingBytesId id, int nbytes, double timeout);
+/**
+ * @brief Register an event to be signalled once the ring buffer holds at
+ * least @c nbytes bytes
+ *
+ * The registered event takes the place of a thread blocked in
+ * epicsRingBytesWaitUsed(); while it is registered waits and other
+ * registrations fail.
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param event Event to signal
+ * @param nbytes Number of bytes to wait for, limited to the size of the
+ * ring
+ * @return 1 if the event was registered, 0 if waiting has not been
+ * enabled on this ring, another waiter is registered, or it is a shared
+ * ring, whose writer can not signal an event in another process
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesAddWaiter(
+    epicsRingBytesId id, epicsEventId event, int nbytes);
+/**
+ * @brief Remove a registration made with epicsRingBytesAddWaiter()
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param event The registered event. Nothing happens if a different
+ * waiter is registered.
+ * @note A writer may signal the event shortly after it has been removed,
+ * so it must not be destroyed while the ring is in use.
+ */
+epicsShareFunc void epicsShareAPI epicsRingBytesRemoveWaiter(
+    epicsRingBytesId id, epicsEventId event);
+
+/**
+ * @brief Write one record into the ring buffer
+ *
+ * The record is stored together with a length header, or not at all.
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param value Source of the record
+ * @param nbytes Length of the record, at least 1. A record takes
+ * EPICS_RING_BYTES_RECORD_HEADER more bytes of ring storage.
+ * @return The number of record bytes stored, zero if not enough space or
+ * if @c nbytes is less than 1
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesPutRecord(
+    epicsRingBytesId id, const char *value, int nbytes);
+/**
+ * @brief Read one record out of the ring buffer
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param value Where to put the record
+ * @param nbytes Size of the buffer at @c value
+ * @return The length of the record fetched, zero if the ring is empty,
+ * or -1 if the next record is longer than @c nbytes, in which case it
+ * is left in the ring
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesGetRecord(
+    epicsRingBytesId id, char *value, int nbytes);
+/**
+ * @brief Get the length of the next record without removing it
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @return The length of the next record, or zero if the ring is empty
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesNextRecordSize(
+    epicsRingBytesId id);
+/**
+ * @brief Reserve space for one record to be written in place
+ *
+ * The record becomes visible to readers when it is committed with
+ * epicsRingBytesCommitRecord().
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param nbytes Length of the record, at least 1
+ * @param span Filled in with up to two spans of ring storage for the
+ * record body, excluding the length header
+ * @return @c nbytes on success, zero if not enough space or if @c nbytes
+ * is less than 1
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesReserveRecord(
+    epicsRingBytesId id, int nbytes, epicsRingBytesSpan span[2]);
+/**
+ * @brief Publish a record reserved with epicsRingBytesReserveRecord()
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param nbytes Final length of the record, no more than was reserved.
+ * Zero abandons the reservation without publishing anything.
+ * @return The length of the record committed
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesCommitRecord(
+    epicsRingBytesId id, int nbytes);
+/**
+ * @brief Look at the next record without removing it
+ *
+ * Release the record with epicsRingBytesConsumeRecord() when done.
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ * @param span Filled in with up to two spans of ring storage holding
+ * the record body
+ * @return The length of the record, or zero if the ring is empty. Always
+ * zero on an overwrite ring buffer.
+ */
+epicsShareFunc int  epicsShareAPI epicsRingBytesPeekRecord(
+    epicsRingBytesId id, epicsRingBytesSpan span[2]);
+/**
+ * @brief Remove the record returned by epicsRingBytesPeekRecord()
+ * @param id RingbufferID returned by epicsRingBytesCreate()
+ */
+epicsShareFunc void epicsShareAPI epicsRingBytesConsumeRecord(
+    epicsRingBytesId id);
 
 #ifdef __cplusplus
 }
@@ -22,15 +22,58 @@
  * @note If there is only one writer it is not necessary to lock pushes.
  * If there is a single reader it is not necessary to lock pops.
  * epicsRingPointerLocked uses a spinlock.
+ *
+ * The single-producer/single-consumer (SPSC) variant gives the same
+ * guarantees as the unlocked kind, but keeps the producer and consumer
+ * indices on separate cache lines, publishes them with explicit memory
+ * barriers, and lets each side work from a cached copy of the other
+ * side's index so that the two threads rarely touch the same line.
+ *
+ * The multi-producer/multi-consumer (MPMC) variant is lock-free and works
+ * with any numbers of writer and reader threads. Each slot carries a
+ * sequence number, so a thread only has to win one compare-and-swap on
+ * the shared push or pop position and never waits for a lock holder.
+ *
+ * A reader can block until enough elements are available with
+ * epicsRingPointer::waitUsed() or epicsRingPointerWaitUsed(), once waiting
+ * has been enabled on the ring. Writers only signal the reader when it is
+ * actually parked, so a busy ring never makes a system call.
+ *
+ * The overwrite variant is secured by a spinlock like the locked kind,
+ * but a push onto a full ring discards the oldest element instead of
+ * failing. The number of discarded elements is counted so readers can
+ * detect gaps.
  */
 
 #ifndef INCepicsRingPointerh
 #define INCepicsRingPointerh
 
 
+#include <stddef.h>
+
 #include "epicsSpin.h"
+#include "epicsAtomic.h"
+#include "epicsEvent.h"
+#include "epicsTime.h"
 #include "shareLib.h"
 
+/** @brief Ways in which an epicsRingPointer can be accessed */
+typedef enum {
+    /** One writer and one reader, no locking */
+    epicsRingPointerUnlocked,
+    /** Any number of writers and readers, secured by a spinlock */
+    epicsRingPointerLocked,
+    /** One writer and one reader, lock-free with cache line separated
+     * indices */
+    epicsRingPointerSPSC,
+    /** Any number of writers and readers, lock-free with sequence
+     * numbered slots */
+    epicsRingPointerMPMC,
+    /** Any number of writers and readers, secured by a spinlock; pushes
+     * onto a full ring discard the oldest element */
+    epicsRingPointerOverwrite
+} epicsRingPointerMode;
+
 #ifdef __cplusplus
 /**
  * @brief A C++ template class providing methods for creating and using a ring
@@ -45,18 +88,55 @@ public: /* Functions */
      * @param locked If true, the spin lock secured variant is created
      */
     epicsRingPointer(int size, bool locked);
+    /**@brief Constructor
+     * @param size Maximum number of elements (pointers) that can be stored
+     * @param mode How the ring will be accessed
+     */
+    epicsRingPointer(int size, epicsRingPointerMode mode);
     /**@brief Destructor
      */
     ~epicsRingPointer();
     /**@brief Push a new entry on the ring
-     * @return True on success, False if the buffer was full
+     * @return True on success, False if the buffer was full. An
+     * overwrite ring always succeeds.
      */
     bool push(T *p);
     /**@brief Take an element off the ring
      * @return The element, or NULL if the ring was empty
      */
     T* pop();
+    /**@brief Push a number of entries on the ring
+     *
+     * The ring lock (if any) is taken once and the new push index is
+     * published once for the whole batch, except on an MPMC ring where
+     * each entry is pushed separately and entries from other threads may
+     * be interleaved with the batch.
+     * @param p Array of pointers to be pushed
+     * @param n Number of entries in @c p; a negative value is taken as 0
+     * @return The number of entries actually pushed, which is less than
+     * @c n if the ring became full. An overwrite ring accepts all @c n
+     * entries, discarding the oldest ones as needed.
+     */
+    int pushN(T * const *p, int n);
+    /**@brief Take a number of elements off the ring
+     *
+     * The ring lock (if any) is taken once and the new pop index is
+     * published once for the whole batch, except on an MPMC ring where
+     * each element is taken separately.
+     * @param p Array to receive the pointers taken from the ring
+     * @param n Maximum number of elements to take; a negative value is
+     * taken as 0
+     * @return The number of elements actually taken, zero if the ring
+     * was empty. Stored NULL entries are taken and counted like any
+     * other.
+     */
+    int popN(T **p, int n);
     /**@brief Remove all elements from the ring.
+     *
+     * On an SPSC ring this may only be called by the consumer thread,
+     * and discards what the producer has published so far. On an MPMC
+     * ring it pops elements until the ring is found empty, so it may
+     * run concurrently with other pushes and pops.
      * @note If this operation is performed on a ring buffer of the
      * unsecured kind, all access to the ring should be locked.
      */
@@ -66,7 +146,9 @@ public: /* Functions */
      */
     int getFree() const;
     /**@brief Get how many elements are stored on the ring
-     * @return The number of elements currently stored.
+     * @return The number of elements currently stored. On an MPMC ring
+     * this includes elements a producer has claimed a slot for but not
+     * yet finished storing.
      */
     int getUsed() const;
     /**@brief Get the size of the ring
@@ -86,6 +168,9 @@ public: /* Functions */
      * Returns the maximum number of elements the ring
      * buffer has held since the water mark was last reset.
      * A new ring buffer starts with a water mark of 0.
+     * @note On an SPSC ring the water mark is sampled by the consumer
+     * whenever it rereads the producer's index, so short bursts that
+     * are drained without the ring ever appearing empty may be missed.
      * @return Actual highwater mark
      */
     int getHighWaterMark() const;
@@ -94,6 +179,60 @@ public: /* Functions */
      * High water mark will be set to the current usage
      */
     void resetHighWaterMark();
+    /**@brief Get how many elements an overwrite ring has discarded
+     *
+     * The count only ever increases, so a reader can compare two values
+     * to find out whether it missed any elements in between.
+     * @return Number of elements discarded since the ring was created,
+     * always 0 for other kinds of ring.
+     */
+    size_t getDropped() const;
+    /**@brief Allow a reader to block on the ring
+     *
+     * Must be called before the ring is shared with other threads.
+     * Afterwards each push checks whether the reader is parked.
+     */
+    void enableWait();
+    /**@brief Wait until the ring holds at least @c count elements
+     * @param count Number of elements to wait for, limited to the size
+     * of the ring
+     * @return True if the elements are available, false if waiting has
+     * not been enabled on this ring or another waiter is registered.
+     * @note Only one thread may wait on a ring at a time.
+     */
+    bool waitUsed(int count);
+    /**@brief Wait until the ring holds at least @c count elements or
+     * until the specified timeout
+     * @param count Number of elements to wait for, limited to the size
+     * of the ring
+     * @param timeout The timeout delay in seconds
+     * @return True if the elements are available, false on timeout, if
+     * waiting has not been enabled on this ring or if another waiter is
+     * registered.
+     * @note Only one thread may wait on a ring at a time.
+     */
+    bool waitUsed(int count, double timeout);
+    /**@brief Register an event to be signalled once the ring holds at
+     * least @c count elements
+     *
+     * This lets one thread wait on several objects at once, see
+     * epicsWaitMany(). The registered event takes the place of a thread
+     * blocked in waitUsed(); while it is registered waitUsed() and other
+     * registrations fail.
+     * @param event Event to signal
+     * @param count Number of elements to wait for, limited to the size
+     * of the ring
+     * @return True if the event was registered, false if waiting has not
+     * been enabled on this ring or another waiter is registered.
+     */
+    bool addWaiter(epicsEventId event, int count);
+    /**@brief Remove a registration made with addWaiter()
+     * @param event The registered event. Nothing happens if a different
+     * waiter is registered.
+     * @note A writer may signal the event shortly after it has been
+     * removed, so it must not be destroyed while the ring is in use.
+     */
+    void removeWaiter(epicsEventId event);
 
 private: /* Prevent compiler-generated member functions */
     /* default constructor, copy constructor, assignment operator */
@@ -101,14 +240,45 @@ private: /* Prevent compiler-generated member functions */
     epicsRingPointer(const epicsRingPointer &);
     epicsRingPointer& operator=(const epicsRingPointer &);
     int getUsedNoLock() const;
+    bool pushSPSC(T *p);
+    T* popSPSC();
+    int pushNSPSC(T * const *p, int n);
+    int popNSPSC(T **p, int n);
+    bool pushMPMC(T *p);
+    bool popMPMC(T *&p);
+    void resetMPMC();
+    void notifyWaiter();
+    void releaseWaiter();
+    void publishPop(int oldPop, int newPop);
+    int getReady() const;
+    static int ringSize(int sz, epicsRingPointerMode mode);
+
+    enum { cacheLineSize = 64 };
 
 private: /* Data */
     epicsSpinId lock;
+    epicsRingPointerMode mode;
+    int size;
+    size_t dropped;
+    T  * volatile * buffer;
+    size_t *sequence;
+    epicsEventId waitEvent;
+    char padPush[cacheLineSize];
+    /* Written by the producer(s) */
     volatile int nextPush;
+    int cachedPop;
+    size_t pushPos;
+    char padPop[cacheLineSize];
+    /* Written by the consumer(s) */
     volatile int nextPop;
-    int size;
+    int cachedPush;
+    size_t popPos;
     int highWaterMark;
-    T  * volatile * buffer;
+    char padWait[cacheLineSize];
+    /* Updated by the waiting reader and by every writer */
+    int waitCount;
+    EpicsAtomicPtrT waiter;
+    char padEnd[cacheLineSize];
 };
 
 extern "C" {
@@ -129,6 +299,35 @@ epicsShareFunc epicsRingPointerId  epicsShareAPI epicsRingPointerCreate(int size
  * @return Ring buffer identifier or NULL on failure
  */
 epicsShareFunc epicsRingPointerId  epicsShareAPI epicsRingPointerLockedCreate(int size);
+/**
+ * @brief Create a new lock-free single-producer/single-consumer ring buffer
+ *
+ * Only one thread may push and only one thread may pop, but the producer
+ * and consumer indices are kept on separate cache lines.
+ * @param size Size of ring buffer to create
+ * @return Ring buffer identifier or NULL on failure
+ */
+epicsShareFunc epicsRingPointerId  epicsShareAPI epicsRingPointerSPSCCreate(int size);
+/**
+ * @brief Create a new lock-free multi-producer/multi-consumer ring buffer
+ *
+ * Any number of threads may push and pop concurrently without taking a
+ * lock. Batch pushes and pops on this kind of ring are not atomic; the
+ * entries of one batch may be interleaved with those of other threads.
+ * @param size Size of ring buffer to create, rounded up to a power of
+ * two; epicsRingPointerGetSize() returns the rounded size
+ * @return Ring buffer identifier or NULL on failure
+ */
+epicsShareFunc epicsRingPointerId  epicsShareAPI epicsRingPointerMPMCCreate(int size);
+/**
+ * @brief Create a new ring buffer that discards its oldest element when
+ * a push finds it full
+ *
+ * The ring is secured by a spinlock, and pushes onto it never fail.
+ * @param size Size of ring buffer to create
+ * @return Ring buffer identifier or NULL on failure
+ */
+epicsShareFunc epicsRingPointerId  epicsShareAPI epicsRingPointerOverwriteCreate(int size);
 /**
  * @brief Delete the ring buffer and free any associated memory
  * @param id Ring buffer identifier
@@ -138,7 +337,9 @@ epicsShareFunc void epicsShareAPI epicsRingPointerDelete(epicsRingPointerId id);
  * @brief Push pointer into the ring buffer
  * @param id Ring buffer identifier
  * @param p Pointer to be pushed to the ring
- * @return 1 if the pointer was successfully pushed, 0 if the buffer was full
+ * @return 1 if the pointer was successfully pushed, 0 if the buffer was
+ * full. Always 1 on an overwrite ring, which discards its oldest element
+ * instead.
  */
 epicsShareFunc int  epicsShareAPI epicsRingPointerPush(epicsRingPointerId id,void *p);
 /**
@@ -147,9 +348,38 @@ epicsShareFunc int  epicsShareAPI epicsRingPointerPush(epicsRingPointerId id,voi
  * @return The pointer from the buffer, or NULL if the ring was empty
  */
 epicsShareFunc void* epicsShareAPI epicsRingPointerPop(epicsRingPointerId id) ;
+/**
+ * @brief Push a number of pointers into the ring buffer
+ *
+ * The whole batch is transferred with a single lock acquisition on a
+ * locked ring.
+ * @param id Ring buffer identifier
+ * @param p Array of pointers to be pushed to the ring
+ * @param n Number of pointers in @c p
+ * @return The number of pointers actually pushed, which is less than
+ * @c n if the buffer became full. Always @c n on an overwrite ring, which
+ * discards its oldest elements instead.
+ */
+epicsShareFunc int  epicsShareAPI epicsRingPointerPushMany(epicsRingPointerId id,
+    void * const *p, int n);
+/**
+ * @brief Take a number of elements off the ring
+ *
+ * The whole batch is transferred with a single lock acquisition on a
+ * locked ring.
+ * @param id Ring buffer identifier
+ * @param p Array to receive the pointers taken from the ring
+ * @param n Maximum number of pointers to take
+ * @return The number of pointers actually taken, zero if the ring was empty
+ */
+epicsShareFunc int  epicsShareAPI epicsRingPointerPopMany(epicsRingPointerId id,
+    void **p, int n);
 /**
  * @brief Remove all elements from the ring
  * @param id Ring buffer identifier
+ * On an SPSC ring this may only be called by the consumer thread. On an
+ * MPMC ring it pops elements until the ring is found empty, so it may run
+ * concurrently with other pushes and pops.
  * @note If this operation is performed on a ring buffer of the unsecured
  * kind, all access to the ring should be locked.
  */
@@ -203,6 +433,76 @@ epicsShareFunc int  epicsShareAPI epicsRingPointerGetHighWaterMark(epicsRingPoin
  */
 epicsShareFunc void epicsShareAPI epicsRingPointerResetHighWaterMark(epicsRingPointerId id);
 
+/**
+ * @brief Get how many elements an overwrite ring has discarded
+ *
+ * The count only ever increases, so a reader can compare two values to
+ * find out whether it missed any elements in between.
+ * @param id Ring buffer identifier
+ * @return Number of elements discarded since the ring was created,
+ * always 0 for other kinds of ring
+ */
+epicsShareFunc size_t epicsShareAPI epicsRingPointerGetDropped(epicsRingPointerIdConst id);
+/**
+ * @brief Allow a reader to block on the ring buffer
+ *
+ * Must be called before the ring is shared with other threads.
+ * @param id Ring buffer identifier
+ */
+epicsShareFunc void epicsShareAPI epicsRingPointerEnableWait(epicsRingPointerId id);
+/**
+ * @brief Wait until the ring buffer holds at least @c count elements
+ *
+ * Writers only signal the reader while it is waiting here.
+ * @param id Ring buffer identifier
+ * @param count Number of elements to wait for, limited to the size of
+ * the ring
+ * @return 1 if the elements are available, 0 if waiting has not been
+ * enabled on this ring or another waiter is registered
+ * @note Only one thread may wait on a ring at a time.
+ */
+epicsShareFunc int  epicsShareAPI epicsRingPointerWaitUsed(epicsRingPointerId id,
+    int count);
+/**
+ * @brief Wait until the ring buffer holds at least @c count elements or
+ * until the specified timeout
+ * @param id Ring buffer identifier
+ * @param count Number of elements to wait for, limited to the size of
+ * the ring
+ * @param timeout The timeout delay in seconds
+ * @return 1 if the elements are available, 0 on timeout, if waiting
+ * has not been enabled on this ring or if another waiter is registered
+ * @note Only one thread may wait on a ring at a time.
+ */
+epicsShareFunc int  epicsShareAPI epicsRingPointerWaitUsedWithTimeout(
+    epicsRingPointerId id, int count, double timeout);
+/**
+ * @brief Register an event to be signalled once the ring buffer holds at
+ * least @c count elements
+ *
+ * The registered event takes the place of a thread blocked in
+ * epicsRingPointerWaitUsed(); while it is registered waits and other
+ * registrations fail.
+ * @param id Ring buffer identifier
+ * @param event Event to signal
+ * @param count Number of elements to wait for, limited to the size of
+ * the ring
+ * @return 1 if the event was registered, 0 if waiting has not been
+ * enabled on this ring or another waiter is registered
+ */
+epicsShareFunc int  epicsShareAPI epicsRingPointerAddWaiter(
+    epicsRingPointerId id, epicsEventId event, int count);
+/**
+ * @brief Remove a registration made with epicsRingPointerAddWaiter()
+ * @param id Ring buffer identifier
+ * @param event The registered event. Nothing happens if a different
+ * waiter is registered.
+ * @note A writer may signal the event shortly after it has been removed,
+ * so it must not be destroyed while the ring is in use.
+ */
+epicsShareFunc void epicsShareAPI epicsRingPointerRemoveWaiter(
+    epicsRingPointerId id, epicsEventId event);
+
 /* This routine was incorrectly named in previous releases */
 #define epicsRingPointerSize epicsRingPointerGetSize
 
@@ -217,42 +517,79 @@ epicsShareFunc void epicsShareAPI epicsRingPointerResetHighWaterMark(epicsRingPo
 
 template <class T>
 inline epicsRingPointer<T>::epicsRingPointer(int sz, bool locked) :
-    lock(0), nextPush(0), nextPop(0), size(sz+1), highWaterMark(0),
-    buffer(new T* [sz+1])
+    lock(0), mode(locked ? epicsRingPointerLocked : epicsRingPointerUnlocked),
+    size(sz+1), dropped(0), buffer(new T* [size]), sequence(0),
+    waitEvent(0), nextPush(0), cachedPop(0), pushPos(0),
+    nextPop(0), cachedPush(0), popPos(0), highWaterMark(0), waitCount(0),
+    waiter(0)
 {
     if (locked)
         lock = epicsSpinCreate();
 }
 
+template <class T>
+inline epicsRingPointer<T>::epicsRingPointer(int sz,
+    epicsRingPointerMode ringMode) :
+    lock(0), mode(ringMode), size(ringSize(sz, ringMode)), dropped(0),
+    buffer(new T* [size]), sequence(0),
+    waitEvent(0), nextPush(0), cachedPop(0), pushPos(0),
+    nextPop(0), cachedPush(0), popPos(0), highWaterMark(0), waitCount(0),
+    waiter(0)
+{
+    if (mode == epicsRingPointerLocked || mode == epicsRingPointerOverwrite)
+        lock = epicsSpinCreate();
+    if (mode == epicsRingPointerMPMC) {
+        sequence = new size_t [size - 1];
+        resetMPMC();
+    }
+}
+
 template <class T>
 inline epicsRingPointer<T>::~epicsRingPointer()
 {
     if (lock) epicsSpinDestroy(lock);
+    if (waitEvent) epicsEventDestroy(waitEvent);
+    delete [] sequence;
     delete [] buffer;
 }
 
 template <class T>
 inline bool epicsRingPointer<T>::push(T *p)
 {
+    if (mode == epicsRingPointerSPSC) return pushSPSC(p);
+    if (mode == epicsRingPointerMPMC) return pushMPMC(p);
     if (lock) epicsSpinLock(lock);
     int next = nextPush;
     int newNext = next + 1;
     if(newNext>=size) newNext=0;
     if (newNext == nextPop) {
-        if (lock) epicsSpinUnlock(lock);
-        return(false);
+        if (mode != epicsRingPointerOverwrite) {
+            if (lock) epicsSpinUnlock(lock);
+            return(false);
+        }
+        int pop = newNext + 1;
+        if (pop >= size) pop = 0;
+        nextPop = pop;
+        dropped++;
     }
     buffer[next] = p;
     nextPush = newNext;
     int used = getUsedNoLock();
     if (used > highWaterMark) highWaterMark = used;
     if (lock) epicsSpinUnlock(lock);
+    if (waitEvent) notifyWaiter();
     return(true);
 }
 
 template <class T>
 inline T* epicsRingPointer<T>::pop()
 {
+    if (mode == epicsRingPointerSPSC) return popSPSC();
+    if (mode == epicsRingPointerMPMC) {
+        T *p = 0;
+        popMPMC(p);
+        return(p);
+    }
     if (lock) epicsSpinLock(lock);
     int next = nextPop;
     if (next == nextPush) {
@@ -267,18 +604,303 @@ inline T* epicsRingPointer<T>::pop()
     return(p);
 }
 
+template <class T>
+inline int epicsRingPointer<T>::pushN(T * const *p, int n)
+{
+    if (n < 0) n = 0;
+    if (mode == epicsRingPointerSPSC) return pushNSPSC(p, n);
+    if (mode == epicsRingPointerMPMC) {
+        int i;
+        for (i = 0; i < n && pushMPMC(p[i]); i++) {}
+        return i;
+    }
+    if (lock) epicsSpinLock(lock);
+    int next = nextPush;
+    int nfree = nextPop - next - 1;
+    if (nfree < 0) nfree += size;
+    int accepted = n;
+    if (n > nfree) {
+        if (mode == epicsRingPointerOverwrite) {
+            /* Only the newest size-1 entries can survive */
+            int skip = n - (size - 1);
+            if (skip > 0) {
+                p += skip;
+                n -= skip;
+                dropped += skip;
+            }
+            int excess = n - nfree;
+            if (excess > 0) {
+                int pop = nextPop + excess;
+                if (pop >= size) pop -= size;
+                nextPop = pop;
+                dropped += excess;
+            }
+        }
+        else {
+            n = accepted = nfree;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        buffer[next] = p[i];
+        if (++next >= size) next = 0;
+    }
+    nextPush = next;
+    int used = getUsedNoLock();
+    if (used > highWaterMark) highWaterMark = used;
+    if (lock) epicsSpinUnlock(lock);
+    if (waitEvent && n > 0) notifyWaiter();
+    return accepted;
+}
+
+template <class T>
+inline int epicsRingPointer<T>::popN(T **p, int n)
+{
+    if (n < 0) n = 0;
+    if (mode == epicsRingPointerSPSC) return popNSPSC(p, n);
+    if (mode == epicsRingPointerMPMC) {
+        int i;
+        for (i = 0; i < n && popMPMC(p[i]); i++) {}
+        return i;
+    }
+    if (lock) epicsSpinLock(lock);
+    int next = nextPop;
+    int nused = nextPush - next;
+    if (nused < 0) nused += size;
+    if (n > nused) n = nused;
+    for (int i = 0; i < n; i++) {
+        p[i] = buffer[next];
+        if (++next >= size) next = 0;
+    }
+    nextPop = next;
+    if (lock) epicsSpinUnlock(lock);
+    return n;
+}
+
 template <class T>
 inline void epicsRingPointer<T>::flush()
 {
+    if (mode == epicsRingPointerSPSC) {
+        int next = nextPop;
+        cachedPush = nextPush;
+        epicsAtomicReadMemoryBarrier();
+        publishPop(next, cachedPush);
+        return;
+    }
+    if (mode == epicsRingPointerMPMC) {
+        T *p;
+        while (popMPMC(p)) {}
+        return;
+    }
     if (lock) epicsSpinLock(lock);
     nextPop = 0;
     nextPush = 0;
     if (lock) epicsSpinUnlock(lock);
 }
 
+/* The SPSC producer only rereads nextPop when its cached copy says the
+ * ring is full, and the consumer only rereads nextPush when its copy says
+ * the ring is empty. The consumer samples the high water mark whenever it
+ * rereads nextPush, so the producer never touches the consumer's line.
+ *
+ * The consumer must finish loading an element before the producer can
+ * see the slot as free. epicsAtomic barriers only order loads against
+ * loads and stores against stores, so nextPop is published with a
+ * compare-and-swap, which orders everything before it. The producer's
+ * stores into a slot depend on its test of the reloaded nextPop, so they
+ * can not be made visible before that load.
+ */
+template <class T>
+inline void epicsRingPointer<T>::publishPop(int oldPop, int newPop)
+{
+    epicsAtomicCmpAndSwapIntT(const_cast<int *>(&nextPop), oldPop, newPop);
+}
+
+template <class T>
+inline bool epicsRingPointer<T>::pushSPSC(T *p)
+{
+    int next = nextPush;
+    int newNext = next + 1;
+    if(newNext>=size) newNext=0;
+    if (newNext == cachedPop) {
+        cachedPop = nextPop;
+        epicsAtomicReadMemoryBarrier();
+        if (newNext == cachedPop)
+            return(false);
+    }
+    buffer[next] = p;
+    epicsAtomicWriteMemoryBarrier();
+    nextPush = newNext;
+    if (waitEvent) notifyWaiter();
+    return(true);
+}
+
+template <class T>
+inline T* epicsRingPointer<T>::popSPSC()
+{
+    int next = nextPop;
+    if (next == cachedPush) {
+        cachedPush = nextPush;
+        epicsAtomicReadMemoryBarrier();
+        if (next == cachedPush)
+            return(0);
+        int used = cachedPush - next;
+        if (used < 0) used += size;
+        if (used > highWaterMark) highWaterMark = used;
+    }
+    T*p  = buffer[next];
+    int newNext = next + 1;
+    if(newNext >=size) newNext = 0;
+    publishPop(next, newNext);
+    return(p);
+}
+
+template <class T>
+inline int epicsRingPointer<T>::pushNSPSC(T * const *p, int n)
+{
+    int next = nextPush;
+    int nfree = cachedPop - next - 1;
+    if (nfree < 0) nfree += size;
+    if (n > nfree) {
+        cachedPop = nextPop;
+        epicsAtomicReadMemoryBarrier();
+        nfree = cachedPop - next - 1;
+        if (nfree < 0) nfree += size;
+        if (n > nfree) n = nfree;
+    }
+    for (int i = 0; i < n; i++) {
+        buffer[next] = p[i];
+        if (++next >= size) next = 0;
+    }
+    epicsAtomicWriteMemoryBarrier();
+    nextPush = next;
+    if (waitEvent && n > 0) notifyWaiter();
+    return n;
+}
+
+template <class T>
+inline int epicsRingPointer<T>::popNSPSC(T **p, int n)
+{
+    int next = nextPop;
+    int nused = cachedPush - next;
+    if (nused < 0) nused += size;
+    if (n > nused) {
+        cachedPush = nextPush;
+        epicsAtomicReadMemoryBarrier();
+        nused = cachedPush - next;
+        if (nused < 0) nused += size;
+        if (nused > highWaterMark) highWaterMark = nused;
+        if (n > nused) n = nused;
+    }
+    int start = next;
+    for (int i = 0; i < n; i++) {
+        p[i] = buffer[next];
+        if (++next >= size) next = 0;
+    }
+    publishPop(start, next);
+    return n;
+}
+
+/* MPMC slot i may be written by the producer that claims position pos
+ * when sequence[i] == pos, and read by the consumer that claims position
+ * pos when sequence[i] == pos + 1. The consumer then advances sequence[i]
+ * by one lap so the next producer can reuse the slot.
+ *
+ * The number of slots is a power of two so that the slot for a position
+ * stays continuous when the size_t positions wrap around.
+ */
+template <class T>
+inline int epicsRingPointer<T>::ringSize(int sz, epicsRingPointerMode mode)
+{
+    if (mode != epicsRingPointerMPMC)
+        return sz + 1;
+    int slots = 1;
+    while (slots < sz) slots <<= 1;
+    return slots + 1;
+}
+
+template <class T>
+inline void epicsRingPointer<T>::resetMPMC()
+{
+    size_t slots = size - 1;
+    for (size_t i = 0; i < slots; i++)
+        epicsAtomicSetSizeT(&sequence[i], i);
+    epicsAtomicSetSizeT(&pushPos, 0);
+    epicsAtomicSetSizeT(&popPos, 0);
+}
+
+template <class T>
+inline bool epicsRingPointer<T>::pushMPMC(T *p)
+{
+    size_t mask = size - 2;
+    size_t pos = epicsAtomicGetSizeT(&pushPos);
+    size_t slot;
+    for (;;) {
+        slot = pos & mask;
+        size_t seq = epicsAtomicGetSizeT(&sequence[slot]);
+        epicsAtomicReadMemoryBarrier();
+        ptrdiff_t diff = (ptrdiff_t)(seq - pos);
+        if (diff == 0) {
+            size_t old = epicsAtomicCmpAndSwapSizeT(&pushPos, pos, pos + 1);
+            if (old == pos) break;
+            pos = old;
+        }
+        else if (diff < 0) {
+            return(false);
+        }
+        else {
+            pos = epicsAtomicGetSizeT(&pushPos);
+        }
+    }
+    buffer[slot] = p;
+    epicsAtomicWriteMemoryBarrier();
+    epicsAtomicSetSizeT(&sequence[slot], pos + 1);
+
+    int used = (int)(pos + 1 - epicsAtomicGetSizeT(&popPos));
+    int mark = epicsAtomicGetIntT(&highWaterMark);
+    while (used > mark) {
+        int old = epicsAtomicCmpAndSwapIntT(&highWaterMark, mark, used);
+        if (old == mark) break;
+        mark = old;
+    }
+    if (waitEvent) notifyWaiter();
+    return(true);
+}
+
+template <class T>
+inline bool epicsRingPointer<T>::popMPMC(T *&p)
+{
+    size_t slots = size - 1;
+    size_t pos = epicsAtomicGetSizeT(&popPos);
+    size_t slot;
+    for (;;) {
+        slot = pos & (slots - 1);
+        size_t seq = epicsAtomicGetSizeT(&sequence[slot]);
+        epicsAtomicReadMemoryBarrier();
+        ptrdiff_t diff = (ptrdiff_t)(seq - (pos + 1));
+        if (diff == 0) {
+            size_t old = epicsAtomicCmpAndSwapSizeT(&popPos, pos, pos + 1);
+            if (old == pos) break;
+            pos = old;
+        }
+        else if (diff < 0) {
+            return(false);
+        }
+        else {
+            pos = epicsAtomicGetSizeT(&popPos);
+        }
+    }
+    p = buffer[slot];
+    /* As for publishPop(), the load must complete before the slot is
+     * handed back; only this consumer can change sequence[slot] now */
+    epicsAtomicCmpAndSwapSizeT(&sequence[slot], pos + 1, pos + slots);
+    return(true);
+}
+
 template <class T>
 inline int epicsRingPointer<T>::getFree() const
 {
+    if (mode == epicsRingPointerMPMC)
+        return size - 1 - getUsedNoLock();
     if (lock) epicsSpinLock(lock);
     int n = nextPop - nextPush - 1;
     if (n < 0) n += size;
@@ -289,6 +911,13 @@ inline int epicsRingPointer<T>::getFree() const
 template <class T>
 inline int epicsRingPointer<T>::getUsedNoLock() const
 {
+    if (mode == epicsRingPointerMPMC) {
+        size_t pop = epicsAtomicGetSizeT(&popPos);
+        ptrdiff_t n = (ptrdiff_t)(epicsAtomicGetSizeT(&pushPos) - pop);
+        if (n < 0) n = 0;
+        if (n > size - 1) n = size - 1;
+        return (int) n;
+    }
     int n = nextPush - nextPop;
     if (n < 0) n += size;
     return n;
@@ -313,6 +942,8 @@ template <class T>
 inline bool epicsRingPointer<T>::isEmpty() const
 {
     bool isEmpty;
+    if (mode == epicsRingPointerMPMC)
+        return getUsedNoLock() == 0;
     if (lock) epicsSpinLock(lock);
     isEmpty = (nextPush == nextPop);
     if (lock) epicsSpinUnlock(lock);
@@ -322,6 +953,8 @@ inline bool epicsRingPointer<T>::isEmpty() const
 template <class T>
 inline bool epicsRingPointer<T>::isFull() const
 {
+    if (mode == epicsRingPointerMPMC)
+        return getUsedNoLock() == size - 1;
     if (lock) epicsSpinLock(lock);
     int count = nextPush - nextPop +1;
     if (lock) epicsSpinUnlock(lock);
@@ -342,6 +975,125 @@ inline void epicsRingPointer<T>::resetHighWaterMark()
     if (lock) epicsSpinUnlock(lock);
 }
 
+template <class T>
+inline size_t epicsRingPointer<T>::getDropped() const
+{
+    if (lock) epicsSpinLock(lock);
+    size_t n = dropped;
+    if (lock) epicsSpinUnlock(lock);
+    return n;
+}
+
+/* Elements a waiting reader can actually pop. On an MPMC ring this stops
+ * at the first slot whose producer has not finished storing into it.
+ */
+template <class T>
+inline int epicsRingPointer<T>::getReady() const
+{
+    if (mode != epicsRingPointerMPMC)
+        return getUsed();
+    size_t mask = size - 2;
+    size_t pos = epicsAtomicGetSizeT(&popPos);
+    int n = 0;
+    while (n < size - 1 &&
+           epicsAtomicGetSizeT(&sequence[(pos + n) & mask]) == pos + n + 1)
+        n++;
+    return n;
+}
+
+template <class T>
+inline void epicsRingPointer<T>::enableWait()
+{
+    if (!waitEvent)
+        waitEvent = epicsEventMustCreate(epicsEventEmpty);
+}
+
+/* The writer publishes its index before reading waitCount, and the
+ * reader sets waitCount before rereading the index. Both sides access
+ * waitCount with an atomic read-modify-write, which orders the earlier
+ * store against the later load (a memory barrier only orders stores
+ * against stores), so at least one of them sees the other's update and a
+ * wakeup cannot be lost.
+ */
+template <class T>
+inline void epicsRingPointer<T>::notifyWaiter()
+{
+    int count = epicsAtomicAddIntT(&waitCount, 0);
+    if (count > 0 && getReady() >= count) {
+        epicsEventId event = (epicsEventId) epicsAtomicGetPtrT(&waiter);
+        if (event) epicsEventSignal(event);
+    }
+}
+
+/* A waiter owns the ring's wait state from claiming waiter until it has
+ * cleared waitCount and then waiter. A writer that read the old count may
+ * still signal the old event, or the next waiter's, which only costs a
+ * spurious wakeup.
+ */
+template <class T>
+inline void epicsRingPointer<T>::releaseWaiter()
+{
+    epicsAtomicSetIntT(&waitCount, 0);
+    epicsAtomicSetPtrT(&waiter, 0);
+}
+
+template <class T>
+inline bool epicsRingPointer<T>::waitUsed(int count)
+{
+    return waitUsed(count, -1.0);
+}
+
+template <class T>
+inline bool epicsRingPointer<T>::waitUsed(int count, double timeout)
+{
+    if (count > size - 1) count = size - 1;
+    if (getReady() >= count) return true;
+    if (!waitEvent) return false;
+
+    epicsUInt64 start = 0;
+    double delay = timeout;
+    if (epicsAtomicCmpAndSwapPtrT(&waiter, 0, waitEvent) != 0)
+        return false;
+    if (timeout > 0.0) start = epicsMonotonicGet();
+    epicsAtomicCmpAndSwapIntT(&waitCount, 0, count);
+    while (getReady() < count) {
+        if (timeout < 0.0) {
+            epicsEventMustWait(waitEvent);
+            continue;
+        }
+        if (delay <= 0.0 ||
+            epicsEventWaitWithTimeout(waitEvent, delay) != epicsEventOK)
+            break;
+        /* Without a usable monotonic clock the time left is unknown,
+         * so give up rather than risk waiting too long */
+        epicsUInt64 now = epicsMonotonicGet();
+        if (start == 0 || now < start)
+            break;
+        delay = timeout - (double)(now - start) * 1e-9;
+    }
+    releaseWaiter();
+    return getReady() >= count;
+}
+
+template <class T>
+inline bool epicsRingPointer<T>::addWaiter(epicsEventId event, int count)
+{
+    if (!waitEvent || !event) return false;
+    if (count > size - 1) count = size - 1;
+    if (count < 1) count = 1;
+    if (epicsAtomicCmpAndSwapPtrT(&waiter, 0, event) != 0)
+        return false;
+    epicsAtomicCmpAndSwapIntT(&waitCount, 0, count);
+    return true;
+}
+
+template <class T>
+inline void epicsRingPointer<T>::removeWaiter(epicsEventId event)
+{
+    if (event && epicsAtomicGetPtrT(&waiter) == (EpicsAtomicPtrT) event)
+        releaseWaiter();
+}
+
 #endif /* __cplusplus */
 
 #endif /* INCepicsRingPointerh */
@@ -50,6 +50,11 @@
  *   the thread has terminated,the results are not defined (but will
  *   normally lead to bad things happening). Thus code that looks after
  *   other threads MUST be aware of threads terminating.
+ * - Placement: epicsThreadCreateOpt accepts an epicsThreadOpts structure
+ *   which can also give the CPUs a thread may run on, its scheduling
+ *   policy and the NUMA node for its memory. These can be changed later
+ *   with the epicsThreadSet routines. Targets that lack a feature ignore
+ *   the corresponding option.
  */
 
 #ifndef epicsThreadh
@@ -163,6 +168,90 @@ epicsShareFunc epicsThreadId epicsShareAPI epicsThreadMustCreate (
     const char * name, unsigned int priority, unsigned int stackSize,
     EPICSTHREADFUNC funptr,void * parm );
 
+/** Scheduling policies for epicsThreadOpts. */
+typedef enum {
+    /** Whatever epicsThreadCreate() would use for the priority given */
+    epicsThreadPolicyDefault,
+    /** Time-sharing, priority is ignored (SCHED_OTHER) */
+    epicsThreadPolicyOther,
+    /** Real-time first in first out (SCHED_FIFO) */
+    epicsThreadPolicyFIFO,
+    /** Real-time round robin (SCHED_RR) */
+    epicsThreadPolicyRR,
+    /** Earliest deadline first with a runtime budget per period
+     *  (SCHED_DEADLINE), priority is ignored */
+    epicsThreadPolicyDeadline
+} epicsThreadPolicy;
+
+/**
+ * Options for epicsThreadCreateOpt(). Always start from
+ * EPICS_THREAD_OPTS_INIT so that options added later get their
+ * default values.
+ **/
+typedef struct epicsThreadOpts {
+    /** Thread priority, between epicsThreadPriorityMin and Max. */
+    unsigned int priority;
+    /** Stack size. Values up to epicsThreadStackBig are taken as an
+     *  epicsThreadStackSizeClass and converted with
+     *  epicsThreadGetStackSize(); larger values are a size in bytes. */
+    unsigned int stackSize;
+    /** CPUs the thread may run on as a list of CPU numbers and ranges
+     *  such as "2-5,8", or NULL for all CPUs. The string is only read
+     *  during epicsThreadCreateOpt() and need not outlive the call. */
+    const char *cpus;
+    /** Scheduling policy. */
+    epicsThreadPolicy policy;
+    /** For epicsThreadPolicyDeadline, the CPU time needed in each period,
+     *  the time by which it must have been given and the period, all in
+     *  seconds. A deadline of 0 means the end of the period. */
+    double runtime, deadline, period;
+    /** NUMA node to allocate the thread's memory from, or -1 for any. */
+    int memoryNode;
+} epicsThreadOpts;
+
+/** Default values for epicsThreadOpts. */
+#define EPICS_THREAD_OPTS_INIT { \
+    epicsThreadPriorityLow, epicsThreadStackMedium, \
+    NULL, epicsThreadPolicyDefault, 0.0, 0.0, 0.0, -1 }
+
+/**
+ * Create a new thread with the given options, see epicsThreadCreate()
+ * for details.
+ * \param name
+ * \param funptr Function that implements the thread.
+ * \param parm single argument passed to funptr.
+ * \param opts Thread options, or NULL for the defaults.
+ * \return thread id or zero on failure, including when the CPU list,
+ * policy or memory node is invalid or not permitted.
+ **/
+epicsShareFunc epicsThreadId epicsShareAPI epicsThreadCreateOpt (
+    const char * name, EPICSTHREADFUNC funptr, void * parm,
+    const epicsThreadOpts * opts );
+
+/**
+ * Change the CPUs the specified thread may run on.
+ * \param id
+ * \param cpus CPU list such as "2-5,8", or NULL for all CPUs.
+ * \return 0 on success, -1 if the list is invalid or not permitted.
+ **/
+epicsShareFunc int epicsShareAPI epicsThreadSetCPUs(
+    epicsThreadId id, const char *cpus);
+
+/**
+ * Change the scheduling policy of the specified thread. The policy,
+ * priority, runtime, deadline and period fields of opts are used.
+ * \return 0 on success, -1 if the policy is not supported or permitted.
+ **/
+epicsShareFunc int epicsShareAPI epicsThreadSetPolicy(
+    epicsThreadId id, const epicsThreadOpts *opts);
+
+/**
+ * Bind future memory allocations of the calling thread to a NUMA node.
+ * \param node NUMA node number, or -1 for any node.
+ * \return 0 on success, -1 on failure.
+ **/
+epicsShareFunc int epicsShareAPI epicsThreadSetMemoryNodeSelf(int node);
+
 /**
  * This causes the calling thread to suspend. The only way it can resume
  * is for another thread to call epicsThreadResume().
@@ -267,6 +356,42 @@ epicsShareFunc epicsThreadId epicsShareAPI epicsThreadGetId(const char *name);
  **/
 epicsShareFunc int epicsThreadGetCPUs(void);
 
+/** Number of cache levels described by epicsThreadCPUInfo. */
+#define EPICS_THREAD_CACHE_LEVELS 4
+
+/** Where a logical CPU sits in the machine. */
+typedef struct epicsThreadCPUInfo {
+    /** Logical CPU number, as used in CPU lists. */
+    int cpu;
+    /** Physical package (socket) number. */
+    int socket;
+    /** NUMA node number, or -1 if unknown. */
+    int node;
+    /** Physical core number, unique across all sockets. */
+    int core;
+    /** SMT sibling number within the core, 0 for the first. */
+    int thread;
+    /** For the data or unified cache at each level (index 0 is the L1
+     *  data cache, then L2, L3, ...), CPUs with the same id share that
+     *  cache; -1 if the level does not exist or is unknown. Instruction
+     *  caches are not reported. */
+    int cacheId[EPICS_THREAD_CACHE_LEVELS];
+    /** Size in bytes of the cache at each level of cacheId, 0 if
+     *  unknown. */
+    size_t cacheSize[EPICS_THREAD_CACHE_LEVELS];
+} epicsThreadCPUInfo;
+
+/**
+ * Describe the CPUs available to the IOC. On Linux this is read from
+ * sysfs. Targets without topology information report every CPU as its
+ * own core on socket 0, with unknown node and caches.
+ * \param info Array to fill in, ordered by logical CPU number.
+ * \param count Number of entries in info.
+ * \return The number of CPUs, which may be more than count; only the
+ * first count entries are filled in.
+ **/
+epicsShareFunc int epicsThreadGetCPUInfo(epicsThreadCPUInfo *info, int count);
+
 /**
  * Get the name of the calling thread.
  **/
@@ -14,6 +14,7 @@
 #include <stdio.h>
 
 #include "shareLib.h"
+#include "epicsTypes.h"
 #include "errMdef.h"
 
 #define S_pool_jobBusy   (M_pool| 1) /*Job already queued or running*/
@@ -22,6 +23,7 @@
 #define S_pool_paused    (M_pool| 4) /*Pool not currently accepting jobs*/
 #define S_pool_noThreads (M_pool| 5) /*Can't create worker thread*/
 #define S_pool_timeout   (M_pool| 6) /*Pool still busy after timeout*/
+#define S_pool_jobCycle  (M_pool| 7) /*Job dependencies would form a cycle*/
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,6 +34,35 @@ typedef struct {
     unsigned int maxThreads;
     unsigned int workerStack;
     unsigned int workerPriority;
+    /* Scheduling of queued jobs.
+     * 0 (default) keeps all jobs on one queue shared by the workers.
+     * 1 gives each worker its own job deque.  Jobs queued from a job
+     * running in the pool go on the current worker's deque, other jobs are
+     * spread over the workers, and an idle worker takes jobs from the far
+     * end of a randomly chosen worker's deque.  Jobs with a priority
+     * other than epicsJobPriorityNormal or with a deadline always use
+     * the shared queue, which workers check before their own deques.
+     */
+    unsigned int workStealing;
+    /* CPUs the workers may run on, as a list of CPU numbers and ranges
+     * such as "2-5,8".  NULL (default) allows all CPUs.  The string is
+     * copied when the pool is created.
+     */
+    const char *workerCPUs;
+    /* 1 pins each worker to a single CPU, taking the CPUs of workerCPUs
+     * in turn so that there is one worker per CPU until they run out.
+     * 0 (default) lets each worker run on any CPU of workerCPUs.
+     */
+    unsigned int workerPinning;
+    /* NUMA node for worker stacks and other worker memory, and whose CPUs
+     * the workers run on if workerCPUs is NULL.  -1 (default) for none.
+     */
+    int workerNode;
+    /* Seconds a worker may stay idle before it exits, as long as more
+     * than initialThreads workers remain.  Workers are started again as
+     * needed, up to maxThreads.  <0 (default) keeps idle workers forever.
+     */
+    double workerLinger;
 } epicsThreadPoolConfig;
 
 typedef struct epicsThreadPool epicsThreadPool;
@@ -51,6 +82,16 @@ typedef enum {
 
 typedef void (*epicsJobFunction)(void* arg, epicsJobMode mode);
 
+/* Job priority classes.
+ * Queued jobs are run in order of priority class, then earliest
+ * deadline, then the order in which they were queued.
+ */
+typedef enum {
+    epicsJobPriorityLow,
+    epicsJobPriorityNormal, /* default */
+    epicsJobPriorityHigh
+} epicsJobPriority;
+
 typedef struct epicsJob epicsJob;
 
 /* Pool operations */
@@ -62,6 +103,10 @@ typedef struct epicsJob epicsJob;
 epicsShareFunc void epicsThreadPoolConfigDefaults(epicsThreadPoolConfig *);
 
 /* fetch or create a thread pool which can be shared with other users.
+ * An existing shared pool is only returned if it was created with the
+ * same workStealing, workerCPUs, workerPinning, workerNode and
+ * workerLinger settings as opts, in addition to the other options.
+ * workerCPUs strings are compared as CPU sets, and NULL only matches NULL.
  * may return NULL for allocation failures
  */
 epicsShareFunc epicsThreadPool* epicsThreadPoolGetShared(epicsThreadPoolConfig *opts);
@@ -97,6 +142,58 @@ epicsShareFunc void epicsThreadPoolControl(epicsThreadPool* pool,
 epicsShareFunc int epicsThreadPoolWait(epicsThreadPool* pool, double timeout);
 
 
+/* Parallel loops */
+
+/* Called for each chunk [begin, end) of a parallel loop */
+typedef void (*epicsThreadPoolForFunction)(void* arg, size_t begin, size_t end);
+
+/* Called for each chunk [begin, end) of a parallel reduction.
+ * partial holds the identity value on entry, and must hold the
+ * chunk's result on return.
+ */
+typedef void (*epicsThreadPoolReduceFunction)(void* arg, size_t begin, size_t end,
+                                              void* partial);
+
+/* Fold a chunk's partial result into the total in result */
+typedef void (*epicsThreadPoolCombineFunction)(void* arg, void* result,
+                                               const void* partial);
+
+/* Split the index range [begin, end) into chunks of grain indices and run
+ * fn on each chunk, using the pool workers and the calling thread.
+ * Blocks until all chunks are done.
+ * grain==0 picks a chunk size giving a few chunks per worker.
+ * May be called from a running job function, in which case the calling
+ * worker takes part instead of waiting idle.
+ * If the workers can not be used (the pool is paused or a job can not be
+ * queued) the calling thread runs the remaining chunks itself, so fn has
+ * always run exactly once for every index when 0 is returned.
+ * Returns 0 for success, or non-zero if pool or fn is NULL, in which
+ * case fn has not been called for any index.
+ */
+epicsShareFunc int epicsThreadPoolParallelFor(epicsThreadPool* pool,
+                                              size_t begin, size_t end,
+                                              size_t grain,
+                                              epicsThreadPoolForFunction fn,
+                                              void* arg);
+
+/* Like epicsThreadPoolParallelFor(), but each chunk produces a partial
+ * result of resultSize bytes which are then combined into result.
+ * On entry result holds the identity value, which is copied to each
+ * chunk's partial result before fn is called.  The partial results are
+ * combined by the calling thread in chunk order, so the total does not
+ * depend on how the chunks were scheduled.
+ * Returns as epicsThreadPoolParallelFor(); on error result is unchanged.
+ */
+epicsShareFunc int epicsThreadPoolParallelReduce(epicsThreadPool* pool,
+                                                 size_t begin, size_t end,
+                                                 size_t grain,
+                                                 epicsThreadPoolReduceFunction fn,
+                                                 epicsThreadPoolCombineFunction combine,
+                                                 void* arg,
+                                                 void* result,
+                                                 size_t resultSize);
+
+
 /* Per job operations */
 
 /* Special flag for epicsJobCreate().
@@ -131,13 +228,71 @@ epicsShareFunc void epicsJobDestroy(epicsJob*);
  */
 epicsShareFunc int epicsJobMove(epicsJob* job, epicsThreadPool* pool);
 
+/* Set the priority class of a job.
+ * Not thread safe.  Job must not be queued.
+ * returns 0 on success, non-zero on error.
+ */
+epicsShareFunc int epicsJobSetPriority(epicsJob* job, epicsJobPriority prio);
+
+/* Give a job a deadline.
+ * Each time the job is queued its deadline becomes the time of the
+ * epicsJobQueue() call plus delay seconds.  Within a priority class jobs
+ * with a deadline run before those without, earliest deadline first.
+ * delay<0 removes the deadline, which is the default.
+ * Not thread safe.  Job must not be queued.
+ * returns 0 on success, non-zero on error.
+ */
+epicsShareFunc int epicsJobSetDeadline(epicsJob* job, double delay);
+
+/* Special values for epicsJobSetAffinity() */
+#define EPICSJOB_AFFINITY_NONE (-1) /* run on any worker (default) */
+#define EPICSJOB_AFFINITY_LAST (-2) /* prefer the worker of the previous run */
+
+/* Ask for a job to run on a particular worker, numbered from 0 as
+ * returned by epicsThreadPoolWorkerIndex(), or pass one of the special
+ * values above.  The job runs on that worker when it is idle, and on
+ * any other worker if it is busy, so affinity never delays a job.
+ * Worker numbers stay below maxThreads.  When a worker retires after
+ * workerLinger its number is freed, and the next worker started takes
+ * the lowest free number.  A job whose worker is not running is treated
+ * as having no affinity until a worker with that number starts again;
+ * for EPICSJOB_AFFINITY_LAST the same applies to the previous worker.
+ * Not thread safe.  Job must not be queued.
+ * returns 0 on success, non-zero on error.
+ */
+epicsShareFunc int epicsJobSetAffinity(epicsJob* job, int worker);
+
+/* Number of the pool worker running the calling job function,
+ * or -1 if not called from a job function.
+ * Numbers run from 0 to maxThreads-1 and are reused by new workers
+ * once a retired worker has freed them.
+ */
+epicsShareFunc int epicsThreadPoolWorkerIndex(void);
+
 /* Adds the job to the run queue
  * Safe to call from a running job function.
+ * In a work stealing pool a job queued from a job running in the same
+ * pool goes on the calling worker's own deque, avoiding the pool lock.
  * returns 0 for success, non-zero on error.
  */
 epicsShareFunc int epicsJobQueue(epicsJob*);
 
+/* Adds n jobs, which must all belong to the same pool, to the run queue
+ * taking the pool lock once and waking only as many idle workers as
+ * there are new jobs for them.
+ * Safe to call from a running job function.
+ * Each job is treated as by epicsJobQueue(), so a job which is already
+ * queued stays queued once, and a running job is queued to run again.
+ * Stops at the first job that epicsJobQueue() would fail for.
+ * If nqueued is not NULL it is set to the number of jobs handled before
+ * the one that failed, or n.
+ * returns 0 for success, or the error status for the failed job.
+ */
+epicsShareFunc int epicsJobQueueMany(epicsJob** jobs, size_t n,
+                                     size_t *nqueued);
+
 /* Remove a job from the run queue if it is queued.
+ * A job held back by predecessors counts as queued, and is removed too.
  * Safe to call from a running job function.
  * returns 0 if job was queued and now is not.
  *         1 if job already ran, is running, or was not queued before,
@@ -146,8 +301,71 @@ epicsShareFunc int epicsJobQueue(epicsJob*);
 epicsShareFunc int epicsJobUnqueue(epicsJob*);
 
 
+/* Make job depend on pred, which must belong to the same pool.
+ * When job is queued it is held back until every predecessor that was
+ * queued or running at that time has finished running, and is then
+ * moved to the run queue without blocking any worker.
+ * A predecessor that is unqueued with epicsJobUnqueue(), destroyed, or
+ * moved to another pool before it runs counts as finished, so the jobs
+ * it holds back are released rather than waiting forever.  A held back
+ * job counts as queued for epicsJobWait() and epicsThreadPoolWait().
+ * Not thread safe.  Job must not be queued.
+ * returns 0 on success, S_pool_jobCycle if job is pred or is already a
+ * direct or indirect predecessor of pred, other non-zero on error.
+ */
+epicsShareFunc int epicsJobAddPredecessor(epicsJob* job, epicsJob* pred);
+
+/* Remove all predecessors of a job.
+ * Not thread safe.  Job must not be queued.
+ * returns 0 on success, non-zero on error.
+ */
+epicsShareFunc int epicsJobClearPredecessors(epicsJob* job);
+
+/* Block until the job is neither queued, held back by predecessors,
+ * nor running.
+ * Should not be called from a job function of the same pool, as the
+ * calling worker would be blocked.
+ *
+ * timeout<0 waits forever, timeout==0 polls, timeout>0 waits at most one timeout period
+ * Returns 0 for success or non-zero on error (timeout is S_pool_timeout)
+ */
+epicsShareFunc int epicsJobWait(epicsJob* job, double timeout);
+
+
+/* Pool statistics */
+
+/* Histogram buckets are powers of two of microseconds.
+ * Bucket 0 counts times under 1us, bucket i times from 2^(i-1)us
+ * up to 2^i us, and the last bucket everything longer.
+ */
+#define EPICS_THREAD_POOL_TIME_BUCKETS 24
+
+typedef struct {
+    unsigned int nThreads;     /* workers now running */
+    unsigned int nIdle;        /* of which waiting for jobs */
+    unsigned int nRetired;     /* workers exited after workerLinger */
+    epicsUInt64 jobsQueued;
+    epicsUInt64 jobsRun;
+    double elapsed;            /* seconds covered by these statistics */
+    double jobsPerSecond;      /* jobsRun/elapsed */
+    double queueWaitTotal;     /* seconds from epicsJobQueue() to start of run */
+    double runTimeTotal;       /* seconds spent in job functions */
+    epicsUInt64 queueWait[EPICS_THREAD_POOL_TIME_BUCKETS];
+    epicsUInt64 runTime[EPICS_THREAD_POOL_TIME_BUCKETS];
+} epicsThreadPoolStats;
+
+/* Copy the statistics gathered since the pool was created or
+ * epicsThreadPoolResetStats() was last called.
+ */
+epicsShareFunc void epicsThreadPoolGetStats(epicsThreadPool *pool,
+                                            epicsThreadPoolStats *stats);
+
+epicsShareFunc void epicsThreadPoolResetStats(epicsThreadPool *pool);
+
+
 /* Mostly useful for debugging */
 
+/* Includes the pool statistics */
 epicsShareFunc void epicsThreadPoolReport(epicsThreadPool *pool, FILE *fd);
 
 /* Current number of active workers.  May be less than the maximum */
@@ -0,0 +1,121 @@
+/*************************************************************************\
+* Copyright (c) 2020 UChicago Argonne LLC, as Operator of Argonne
+*     National Laboratory.
+* EPICS BASE is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/**@file epicsWaitMany.h
+ *
+ * @brief Wait until any one of several queues, events or rings is ready.
+ *
+ * A thread that serves several message queues, events and ring buffers
+ * can block on all of them in a single call instead of polling each in
+ * turn. The caller describes each object with an epicsWaitItem, and the
+ * call returns the index of the first item found to be ready.
+ *
+ * An item is ready when:
+ * - a message queue has at least one message pending,
+ * - an event is full; the event is emptied as epicsEventWait() would,
+ * - a ring buffer holds at least @c count elements or bytes.
+ *
+ * Apart from events, nothing is taken from a ready object; the caller
+ * does that with the normal receive, pop or get routines.
+ *
+ * The call registers one event of its own with every object, using
+ * epicsMessageQueueAddWaiter(), epicsEventAddWaiter(),
+ * epicsRingPointerAddWaiter() and epicsRingBytesAddWaiter(), and removes
+ * the registrations before it returns.
+ *
+ * The consumer thread might contain:
+ @code
+       epicsWaitItem items[3];
+       items[0].type = epicsWaitEvent;
+       items[0].id.event = shutdown;
+       items[1].type = epicsWaitMessageQueue;
+       items[1].id.queue = requests;
+       items[2].type = epicsWaitRingPointer;
+       items[2].id.ringPointer = samples;
+       items[2].count = 16;
+       for (;;) {
+           int ready = epicsWaitMany(items, 3);
+           if (ready <= 0) break;
+           {receive or pop from the ready item and process it}
+       }
+ @endcode
+ **/
+
+#ifndef epicsWaitManyh
+#define epicsWaitManyh
+
+#include "shareLib.h"
+#include "epicsEvent.h"
+#include "epicsMessageQueue.h"
+#include "epicsRingPointer.h"
+#include "epicsRingBytes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Kinds of object that can be waited for */
+typedef enum {
+    epicsWaitMessageQueue,
+    epicsWaitEvent,
+    epicsWaitRingPointer,
+    epicsWaitRingBytes
+} epicsWaitType;
+
+/** @brief Returned when the timeout expired before any item was ready */
+#define epicsWaitManyTimeout (-1)
+/** @brief Returned when an item is invalid or can not be waited for */
+#define epicsWaitManyError (-2)
+
+/** @brief One object to wait for */
+typedef struct epicsWaitItem {
+    /** @brief Which member of @c id is used */
+    epicsWaitType type;
+    /** @brief The object to wait for */
+    union {
+        epicsMessageQueueId queue;
+        epicsEventId event;
+        epicsRingPointerId ringPointer;
+        epicsRingBytesId ringBytes;
+    } id;
+    /** @brief For ring buffers, the number of elements or bytes needed;
+     * ignored for other objects */
+    int count;
+} epicsWaitItem;
+
+/**@brief Wait until any of the items is ready.
+ *
+ * If several items are ready the lowest index is returned.
+ * @param items Array of items to wait for.
+ * @param nitems Number of entries in @c items.
+ * @return Index of the ready item, or epicsWaitManyError if an item is
+ * invalid, is a shared ring buffer, is a ring buffer without waiting
+ * enabled, or already has a waiter registered.
+ * @note A thread blocked in epicsRingPointerWaitUsed() or
+ * epicsRingBytesWaitUsed() counts as a registered waiter, as does
+ * another thread in epicsWaitMany() on the same object.
+ **/
+epicsShareFunc int epicsWaitMany(const epicsWaitItem *items,
+    unsigned int nitems);
+
+/**@brief Wait until any of the items is ready or until the specified
+ * timeout.
+ * @param items Array of items to wait for.
+ * @param nitems Number of entries in @c items.
+ * @param timeOut The timeout delay in seconds.
+ * @return Index of the ready item, epicsWaitManyTimeout on timeout, or
+ * epicsWaitManyError if an item can not be waited for, as for
+ * epicsWaitMany().
+ **/
+epicsShareFunc int epicsWaitManyWithTimeout(const epicsWaitItem *items,
+    unsigned int nitems, double timeOut);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* epicsWaitManyh */
@@ -1,3 +1,20 @@
 /*
- * Nothing needed for default implementation
+ * Nothing needed for the Linux implementation.
+ *
+ * A queue with a single priority lane does not use the default
+ * mutex-plus-event implementation on Linux. Its messages are kept in a
+ * ring of fixed-size slots whose ownership is passed between senders and
+ * receivers with atomic sequence numbers, so a send or receive on a queue
+ * that is neither empty nor full takes no lock. The batch routines claim
+ * all their slots with one atomic update of the ring position. A thread
+ * only parks, on a futex, when it finds the queue empty (receivers) or
+ * full (senders), and the other side only makes the futex wake system
+ * call when a thread is actually parked. The timeout semantics of
+ * epicsMessageQueueSendWithTimeout() and epicsMessageQueueReceiveWithTimeout()
+ * are unchanged.
+ *
+ * Reserved and borrowed slots are simply slots whose ownership has been
+ * claimed but not yet passed on. The statistics are kept with 64-bit
+ * atomic counters, the wait times in nanoseconds. Queues with more than
+ * one priority lane use the default implementation.
  */